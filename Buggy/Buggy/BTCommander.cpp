@@ -11,7 +11,7 @@
 #include "BTCommander.hh"
 
 BTCommander::BTCommander(Commander::Responder * R) :
-  Commander(R),
+  Commander(R, ct_Bluetooth),
 #ifdef FEATHER_M0_BTLE
   m_ble(new Adafruit_BluefruitLE_SPI(8, 7, 4)), // Feather M0 BTLE
 #else
@@ -162,11 +162,7 @@ const char * BTCommander::name() const {
 void BTCommander::update() {
 #ifdef FEATHER_M0_BTLE
   while (get_bytes()) {
-    const char * ptr = m_ble->buffer;
-
-    while (*ptr) {
-      push(*ptr++);
-    }
+    push(m_ble->buffer, strlen(m_ble->buffer));
   }
 
   int max_bt = available();
@@ -176,10 +172,15 @@ void BTCommander::update() {
   if (count) {
     m_ble->print("AT+BLEUARTTX=");
 
-    for (int i = 0; i < count; i++) {
-      char c;
-      m_fifo.pop(c);
-      m_ble->write(c);
+    while (count) { // one span, or two if the data wraps around
+      const char * span;
+      int length = m_fifo.peek_span(span);
+      if (length > count) {
+        length = count;
+      }
+      m_ble->write(span, length);
+      m_fifo.consume(length);
+      count -= length;
     }
     m_ble->println();
     if (!m_ble->waitForOK()) {
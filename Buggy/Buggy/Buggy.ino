@@ -8,6 +8,7 @@
 #include "config.hh"
 #include "Timer.hh"
 #include "SerialCommander.hh"
+#include "Format.hh"
 
 #ifdef ENABLE_BLUETOOTH
 #include "BTCommander.hh"
@@ -19,7 +20,8 @@
 #include "Encoders.hh"
 #endif
 #ifdef ENABLE_GPS
-#include <Adafruit_GPS.h>
+#include <Adafruit_GPS.h> // for the PMTK setup commands only; see NMEA.hh for parsing
+#include "NMEA.hh"
 #endif
 #ifdef ENABLE_JOYWING
 #include "Joy.hh"
@@ -29,6 +31,38 @@ class Joy;
 
 #ifdef APP_MOTORCONTROL
 #include "Claw.hh"
+#include "Registry.hh"
+#ifdef ENABLE_ENC_CLASS
+#include "Control.hh"
+#endif
+
+/* Tuning parameters that can be set by command & read back with "G"
+ */
+static constexpr Registry::Param s_params[] = {
+  Registry::Param('S', &TB_Params.slip, 100, 0, 10000),
+  Registry::Param('P', &MC_Params.P,    100, 0, 10000),
+  Registry::Param('I', &MC_Params.I,    100, 0, 10000),
+  Registry::Param('D', &MC_Params.D,    100, 0, 10000),
+  Registry::Param('Q', &TB_Params.P,    100, 0, 10000),
+  Registry::Param('J', &TB_Params.I,    100, 0, 10000),
+  Registry::Param('E', &TB_Params.D,    100, 0, 10000),
+  Registry::Param('l', &M2_enable),
+  Registry::Param('r', &M1_enable)
+};
+#endif
+
+#ifdef APP_FORWARDING
+#define ROUTE(t) (1U << Commander::t)
+
+/* Forwarding table: for each source, the set of destinations of a received command
+ */
+static constexpr unsigned s_route[Commander::ct_Count] = {
+  ROUTE(ct_Serial1),                       // ct_Serial0
+  ROUTE(ct_Serial0) | ROUTE(ct_Bluetooth), // ct_Serial1
+  0,                                       // ct_Serial2
+  ROUTE(ct_Serial1),                       // ct_Bluetooth
+  ROUTE(ct_Serial1)                        // ct_LoRa
+};
 #endif
 
 class Buggy : public Timer, public Commander::Responder {
@@ -48,8 +82,22 @@ private:
 #endif
 #ifdef ENABLE_GPS
   Adafruit_GPS *gps;
+  NMEA nmea;
 #endif
   Joy *J;
+#ifdef ENABLE_JOYWING
+  bool bJoyChanged;
+#endif
+#ifdef APP_FORWARDING
+  Commander *route[Commander::ct_Count]; // by transport ID; zero if absent
+#endif
+
+#ifdef APP_MOTORCONTROL
+  Registry registry;
+#endif
+#if defined(APP_MOTORCONTROL) && defined(ENABLE_ENC_CLASS)
+  Control control;
+#endif
 
   elapsedMicros report;
   unsigned char reportMode;
@@ -74,6 +122,12 @@ public:
     gps(new Adafruit_GPS(&Serial3)),
 #endif
     J(0),
+#ifdef ENABLE_JOYWING
+    bJoyChanged(false),
+#endif
+#ifdef APP_MOTORCONTROL
+    registry(s_params, sizeof(s_params) / sizeof(s_params[0])),
+#endif
     report(0),
     reportMode(0),
     bReportGenerated(false)
@@ -89,12 +143,49 @@ public:
 #endif
 #ifdef ENABLE_JOYWING
     J = Joy::joy();
+#endif
+#ifdef ENABLE_IDLE
+    idle(true);
+#endif
+#if defined(APP_MOTORCONTROL) && defined(ENABLE_ENC_CLASS)
+    control.begin(); // the encoders are set up already, in setup()
+#endif
+#ifdef APP_FORWARDING
+    for (int i = 0; i < Commander::ct_Count; i++) {
+      route[i] = 0;
+    }
+    route[s0.id()] = &s0;
+    route[s1.id()] = &s1;
+#ifdef ENABLE_BLUETOOTH
+    if (bt) {
+      route[bt->id()] = bt;
+    }
+#endif
+#ifdef ENABLE_LORA
+    if (lora) {
+      route[lora->id()] = lora;
+    }
+#endif
+#ifdef ENABLE_BRIDGE
+    for (int i = 0; i < Commander::ct_Count; i++) {
+      if (route[i]) {
+        route[i]->bridge(route[i] == &s1 ? "p$" : ""); // Serial1 'p' & text are printed, not forwarded
+      }
+    }
+#endif
 #endif
     //pinMode(2, INPUT);
   }
   virtual ~Buggy() {
     // ...
   }
+  void report_mode(unsigned char mode) {
+    reportMode = mode; // 0 for none; 1 for GPS-triggered reporting; 2 for buggy 'actual' at 10ms intervalsb
+    if ((reportMode == 4) != profiling()) { // 4 for task profiling (& idle), reported every second
+      profile_clear();
+      profile(reportMode == 4);
+    }
+  }
   bool reporting() {
     return (reportMode == 1) /* || digitalRead(2) */;
   }
@@ -137,18 +228,30 @@ public:
         bt->ui((char) (value & 0xFF));
       }      
 #endif
-    } else if (strcmp(C->name(), "s1") == 0) { // command received from Serial1; forward to others
-      s0.command_send(code, value);
-#ifdef ENABLE_BLUETOOTH
-      if (bt) {
-        bt->command_send(code, value);
+    } else { // forward to each destination in the routing table, formatting only once
+      unsigned mask = s_route[C->id()];
+
+      if (mask) {
+        char frame[16];
+        int length = Commander::format(frame, code, value);
+
+        for (int i = 0; i < Commander::ct_Count; i++) {
+          if ((mask & (1U << i)) && route[i]) {
+            route[i]->command_frame(frame, length);
+          }
+        }
       }
+    }
 #endif
-    } else {                                   // command received from others; forward to Serial1
-      s1.command_send(code, value);
+#if !defined(APP_FORWARDING) && !defined(APP_MOTORCONTROL)
+    if (code == 'R') {
+      report_mode((unsigned char) (value & 0xFF));
     }
 #endif
 #ifdef APP_MOTORCONTROL
+    if (registry.set(code, value)) { // tuning parameters
+      return;
+    }
     switch(code) {
     case 'f':
       MSpeed = (value > 127 ? 127 : value);
@@ -162,38 +265,14 @@ public:
       MSpeed = 0;
       TB_Params.target = 0.0;
       break;
-    case 'l':
-      M2_enable = value ? true : false;
-      break;
-    case 'r':
-      M1_enable = value ? true : false;
-      break;
     case 'c':
       if (value == 1) s_roboclaw_init(); // for testing only
       break;
-    case 'S':
-      TB_Params.slip = (float) value / 100.0;
-      break;
-    case 'P':
-      MC_Params.P = (float) value / 100.0;
-      break;
-    case 'I':
-      MC_Params.I = (float) value / 100.0;
-      break;
-    case 'D':
-      MC_Params.D = (float) value / 100.0;
-      break;
-    case 'Q':
-      TB_Params.P = (float) value / 100.0;
-      break;
-    case 'J':
-      TB_Params.I = (float) value / 100.0;
-      break;
-    case 'E':
-      TB_Params.D = (float) value / 100.0;
+    case 'G':
+      registry.get(C, value); // read back one or all tuning parameters
       break;
     case 'R':
-      reportMode = (unsigned char) (value & 0xFF); // 0 for none; 1 for GPS-triggered reporting; 2 for buggy 'actual' at 10ms intervalsb
+      report_mode((unsigned char) (value & 0xFF));
       break;
     default:
       break;
@@ -201,8 +280,46 @@ public:
 #endif
   }
 
+  virtual void text(Commander * C, const char * str, int length) {
+#ifdef APP_FORWARDING
+    if (length) {
+      s0.ui_write(str, length);
+#ifdef ENABLE_BLUETOOTH
+      if (bt) {
+        bt->ui_write(str, length);
+      }
+#endif
+    } else { // end of string
+      s0.ui();
+#ifdef ENABLE_BLUETOOTH
+      if (bt) {
+        bt->ui();
+      }
+#endif
+    }
+#endif
+  }
+
+  virtual void relay(Commander * C, const char * bytes, int length) {
+#ifdef APP_FORWARDING
+    unsigned mask = s_route[C->id()];
+
+    for (int i = 0; i < Commander::ct_Count; i++) {
+      if ((mask & (1U << i)) && route[i]) {
+        route[i]->command_frame(bytes, length);
+      }
+    }
+#endif
+  }
+
   virtual void every_milli() { // runs once a millisecond, on average
-    // ...
+#if defined(APP_MOTORCONTROL) && defined(ENABLE_ENC_CLASS) && defined(ENABLE_PID)
+    Control::Output O;
+
+    if (control.output(O)) { // the latest motor commands from the control loop, if new
+      s_roboclaw_set(O.M1, O.M2); // right, left
+    }
+#endif
   }
 
   virtual void every_10ms() { // runs once every 10ms, on average
@@ -218,8 +335,6 @@ public:
     if (M1 > MSpeed) {
       --M1;
     }
-    s_roboclaw_set_M1(M1); // right
-
     int M2 = M2_actual;
 
     if (M2 < MSpeed) {
@@ -228,12 +343,10 @@ public:
     if (M2 > MSpeed) {
       --M2;
     }
-    s_roboclaw_set_M2(M2); // left
+    s_roboclaw_set(M1, M2); // right, left
 
     if ((reportMode == 3) && (MSpeed || M1_actual || M2_actual)) {
-      char buf[40];
-      snprintf(buf, 40, "%d %d/%d %d/%d", MSpeed, M1, M1_actual, M2, M2_actual);
-      s0.ui_print(buf);
+      Format(s0).dec(MSpeed).ch(' ').dec(M1).ch('/').dec(M1_actual).ch(' ').dec(M2).ch('/').dec(M2_actual);
       s0.ui();
     }
 #endif // ! ENABLE_PID
@@ -244,29 +357,16 @@ public:
     }
 #endif
 #ifdef ENABLE_ENC_CLASS
-    E1.sync();
-    E2.sync();
-    E3.sync();
-    E4.sync();
-
-    const float scaling = PI * WHEEL_DIAMETER * 3.6;
-
-    TB_Params.actual_FL = E1.latest() * scaling; // * * * FIXME - which encoders correspond to which wheels? * * *
-    TB_Params.actual_BL = E2.latest() * scaling; // Note: Important: Check! Is +ve forwards on the left and backwards on the right?
-    TB_Params.actual_FR = E3.latest() * scaling; // Also FIXME: This should be the only place .latest() is used. Tidy up instances below.
-    TB_Params.actual_BR = E4.latest() * scaling;
-
-    TB_Params.actual = (TB_Params.actual_FL - TB_Params.actual_BR) / 2.0;
+    if (!control.timed()) {
+      control.step(); // see Control.hh
+    }
 
     if ((reportMode == 2) && (TB_Params.actual_FL || TB_Params.actual_BL || TB_Params.actual_FR || TB_Params.actual_BR || TB_Params.actual)) {
-      char buf[40];
-      snprintf(buf, 40, "%6.2f %6.2f %6.2f %6.2f %6.2f", TB_Params.actual_FL, TB_Params.actual_BL, TB_Params.actual_FR, TB_Params.actual_BR, TB_Params.actual);
-      s0.ui_print(buf);
+      Format(s0).fixed(TB_Params.actual_FL, 2, 6).ch(' ').fixed(TB_Params.actual_BL, 2, 6).ch(' ')
+                 .fixed(TB_Params.actual_FR, 2, 6).ch(' ').fixed(TB_Params.actual_BR, 2, 6).ch(' ')
+                 .fixed(TB_Params.actual, 2, 6);
       s0.ui();
     }
-#ifdef ENABLE_PID
-    s_buggy_update(10); // see Claw.hh
-#endif // ENABLE_PID
 #endif
   }
 
@@ -281,15 +381,15 @@ public:
 
 #ifdef APP_MOTORCONTROL
     if (tenth == 0 || tenth == 5) { // i.e., every half-second
-      const float d_wheel = WHEEL_DIAMETER; // Wheel diameter [m]
       bool moving = false;
 #ifdef ENABLE_ENC_CLASS
-      float vs1 = E1.latest() * PI * d_wheel * 3.6; // Vehicle speed in km/h
-      float vs2 = E2.latest() * PI * d_wheel * 3.6; // Vehicle speed in km/h
-      float vs3 = E3.latest() * PI * d_wheel * 3.6; // Vehicle speed in km/h
-      float vs4 = E4.latest() * PI * d_wheel * 3.6; // Vehicle speed in km/h
+      float vs1 = TB_Params.actual_FL; // Vehicle speed in km/h
+      float vs2 = TB_Params.actual_BL;
+      float vs3 = TB_Params.actual_FR;
+      float vs4 = TB_Params.actual_BR;
       moving = vs1 || vs2 || vs3 || vs4;
 #else
+      const float d_wheel = WHEEL_DIAMETER; // Wheel diameter [m]
       float vehicle_speed = s_encoder_rpm() * PI * d_wheel * 0.06; // Vehicle speed in km/h
       moving = vehicle_speed;
 #endif
@@ -297,15 +397,11 @@ public:
       if (moving || MSpeed || M1_actual || M2_actual) {
         char str[64];
 #ifdef ENABLE_ENC_CLASS
-        snprintf(str, 64, "M: %d {%d %d} v: %.2f %.2f %.2f %.2f km/h", MSpeed, M1_actual, M2_actual, vs1, vs2, vs3, vs4);
+        Format(str, 64).str("M: ").dec(MSpeed).str(" {").dec(M1_actual).ch(' ').dec(M2_actual).str("} v: ")
+                       .fixed(vs1, 2).ch(' ').fixed(vs2, 2).ch(' ').fixed(vs3, 2).ch(' ').fixed(vs4, 2).str(" km/h");
 #else
-        if (encoderForwards) {
-          // str += "Forwards";
-          snprintf(str, 64, "MSpeed: %d {%d,%d}; Speed: %.2f km/h; Dir.: F", MSpeed, M1_actual, M2_actual, vehicle_speed);
-        } else {
-          // str += "Backwards";
-          snprintf(str, 64, "MSpeed: %d {%d,%d}; Speed: %.2f km/h; Dir.: B", MSpeed, M1_actual, M2_actual, vehicle_speed);
-        }
+        Format(str, 64).str("MSpeed: ").dec(MSpeed).str(" {").dec(M1_actual).ch(',').dec(M2_actual).str("}; Speed: ")
+                       .fixed(vehicle_speed, 2).str(" km/h; Dir.: ").ch(encoderForwards ? 'F' : 'B');
 #endif
 #ifndef ENABLE_GPS
         if (Serial) {
@@ -313,6 +409,14 @@ public:
         }
 #endif
         s2.command_print(str);
+#ifdef ENABLE_ROBOCLAW
+        if (Claw_Telemetry.updated) { // see ClawTelemetry in Claw.hh
+          Format(str, 64).str("I: ").fixed(Claw_Telemetry.current_M1, 2).ch(' ').fixed(Claw_Telemetry.current_M2, 2)
+                         .str(" A T: ").fixed(Claw_Telemetry.temperature, 1).str(" C V: ").fixed(Claw_Telemetry.battery, 1)
+                         .str(" V E: ").hex(Claw_Telemetry.error);
+          s2.command_print(str);
+        }
+#endif
       }
     }
 #endif
@@ -327,13 +431,21 @@ public:
     }
 #endif
 #ifdef ENABLE_JOYWING
-    if (J) {
-      J->start(); // start communication sequence
+    if (J && bJoyChanged) { // the joystick is sampled continuously, but changes are sent at most once per tenth
+      bJoyChanged = false;
+#ifdef ENABLE_LORA
+      if (lora) {
+        lora->command_print(joy_status().c_str());
+      }
+#endif
     }
 #endif
   }
 
   virtual void every_second() { // runs once every second
+    if (reportMode == 4) {
+      generate_profile();
+    }
 #ifdef ENABLE_LORA
     static unsigned long count = 0;
 
@@ -345,68 +457,143 @@ public:
 #endif
   }
 
-  void generate_report() {
-    char buf[48];
-
+  void generate_profile() { // execution time (us) & scheduling of each task over the last second
+    static const char * s_task_name[] = { "1ms", "10ms", "0.1s", "1s" };
+
+    for (int i = 0; i < count(); i++) {
+      int task = id(i);
+      const Scheduler::Stats & S = stats(i);
+      char buf[128];
+
+      if (task < TIMER_PROFILE_MAX) {
+        const Profile & P = profile_of(task);
+        snprintf(buf, 128, "%s: n=%lu min=%lu mean=%lu max=%lu late=%lu over=%lu skip=%lu [%lu %lu %lu %lu %lu %lu %lu %lu]",
+                 (task < ti_User) ? s_task_name[task] : "task", P.count, P.min, P.count ? P.sum / P.count : 0, P.max,
+                 S.late, S.overruns, S.skipped,
+                 P.bins[0], P.bins[1], P.bins[2], P.bins[3], P.bins[4], P.bins[5], P.bins[6], P.bins[7]);
+      } else {
+        snprintf(buf, 128, "task %d: late=%lu over=%lu skip=%lu", task, S.late, S.overruns, S.skipped);
+      }
+      s0.ui_print(buf);
+      s0.ui();
+      clear(i);
+    }
+#ifdef ENABLE_ENC_CLASS
+    {
+      for (int e = 0; e < Encoders_t::N; e++) {
+        const Encoder::Quality & Q = Encoders.encoder(e).quality();
+        char buf[96];
+        snprintf(buf, 96, "enc %d: edges=%lu window=%lu age=%lu illegal=%lu dropped=%lu",
+                 e + 1, Q.edges, Q.window, Q.age, Q.illegal, Q.dropped);
+        s0.ui_print(buf);
+        s0.ui();
+      }
+    }
+#ifdef APP_MOTORCONTROL
+    {
+      Control::Jitter C;
+      control.jitter(C);
+      control.jitter_clear();
+
+      char buf[128];
+      snprintf(buf, 128, "control: %s period=%lu n=%lu interval: min=%lu max=%lu jitter: mean=%lu max=%lu run: max=%lu",
+               control.timed() ? "timer" : "10ms", control.period(), C.count, C.interval_min, C.interval_max,
+               C.count ? C.jitter_sum / C.count : 0, C.jitter_max, C.run_max);
+      s0.ui_print(buf);
+      s0.ui();
+    }
+#endif
+#endif
 #ifdef ENABLE_GPS
-    snprintf(buf, 48, "%02d/%02d/20%02d,%02d.%02d,%02d.%04u,",
-      (int) gps->day,
-      (int) gps->month,
-      (int) gps->year,
-      (int) gps->hour,
-      (int) gps->minute,
-      (int) gps->seconds,
-      (unsigned int) gps->milliseconds);
-    s0.ui_print(buf);
-
-    if (gps->fix) {
-      float coord = abs(gps->latitudeDegrees);
-      int degrees = (int) coord;
-      coord = (coord - (float) degrees) * 60;
-      int minutes = (int) coord;
-      coord = (coord - (float) minutes) * 60;
-            
-      snprintf(buf, 48, "%3d^%02d'%.4f\"%c,", degrees, minutes, coord, gps->lat ? gps->lat : ((gps->latitudeDegrees < 0) ? 'S' : 'N'));
+    {
+      const NMEA::Stats & N = nmea.stats();
+      char buf[64];
+      snprintf(buf, 64, "gps: n=%lu errors=%lu ignored=%lu", N.sentences, N.errors, N.ignored);
       s0.ui_print(buf);
-            
-      coord = abs(gps->longitudeDegrees);
-      degrees = (int) coord;
-      coord = (coord - (float) degrees) * 60;
-      minutes = (int) coord;
-      coord = (coord - (float) minutes) * 60;
-            
-      snprintf(buf, 48, "%3d^%02d'%.4f\"%c,", degrees, minutes, coord, gps->lon ? gps->lon : ((gps->longitudeDegrees < 0) ? 'W' : 'E'));
+      s0.ui();
+      nmea.clear();
+    }
+#endif
+#ifdef ENABLE_ROBOCLAW
+    {
+      const ClawLink::Stats & C = claw.stats();
+      unsigned long good = C.count - C.timeouts - C.errors;
+      char buf[96];
+      snprintf(buf, 96, "claw: n=%lu timeouts=%lu errors=%lu latency: min=%lu mean=%lu max=%lu",
+               C.count, C.timeouts, C.errors, C.latency_min, good ? C.latency_sum / good : 0, C.latency_max);
       s0.ui_print(buf);
-
-      snprintf(buf, 48, "%.6f,%.6f,", gps->latitudeDegrees, gps->longitudeDegrees);
+      s0.ui();
+      claw.clear();
+    }
+#endif
+#ifdef ENABLE_JOYWING
+    {
+      char buf[32];
+      snprintf(buf, 32, "joy: rate=%u/s", J->rate());
       s0.ui_print(buf);
+      s0.ui();
+    }
+#endif
+    if (idling()) {
+      const Idle & I = idle_stats();
+      char buf[96];
+      snprintf(buf, 96, "idle: n=%lu asleep=%lu wake: n=%lu mean=%lu max=%lu",
+               I.count, I.asleep, I.wakes, I.wakes ? I.wake_sum / I.wakes : 0, I.wake_max);
+      s0.ui_print(buf);
+      s0.ui();
+    }
+    profile_clear();
+  }
+
+#ifdef ENABLE_JOYWING
+  String joy_status() {
+    String joy("x=");
+    joy += String(J->x()) + String("; y=") + String(J->y()) + String("; b=");
+    if (J->up())     joy += 'u';
+    if (J->down())   joy += 'd';
+    if (J->left())   joy += 'l';
+    if (J->right())  joy += 'r';
+    if (J->select()) joy += 's';
+    return joy;
+  }
+#endif
+
+  void generate_report() {
+    Format R(s0); // straight into the output buffer
+
+#ifdef ENABLE_GPS
+    const NMEA::Fix & F = nmea.fix();
+
+    R.udec(F.day, 2, '0').ch('/').udec(F.month, 2, '0').str("/20").udec(F.year, 2, '0').ch(',');
+    R.udec(F.hour, 2, '0').ch('.').udec(F.minute, 2, '0').ch(',').udec(F.seconds, 2, '0').ch('.').udec(F.milliseconds, 4, '0').ch(',');
+
+    if (F.fix) {
+      R.dms(F.latitude,  'N', 'S').ch(',');
+      R.dms(F.longitude, 'E', 'W').ch(',');
+      R.fixed(F.latitude, 7, 6).ch(',').fixed(F.longitude, 7, 6).ch(','); // degrees x 10^7
     } else {
-      s0.ui_print(",,,,");
+      R.str(",,,,");
     }
 #endif
 
-    snprintf(buf, 48, "%10lu", (unsigned long) millis());
-    s0.ui_print(buf);
+    R.udec(millis(), 10);
 
 #ifdef APP_MOTORCONTROL
-    snprintf(buf, 48, ",%3d,%3d,%3d,", MSpeed, M1_actual, M2_actual);
-    s0.ui_print(buf);
-
-    const float d_wheel = WHEEL_DIAMETER;
+    R.ch(',').dec(MSpeed, 3).ch(',').dec(M1_actual, 3).ch(',').dec(M2_actual, 3).ch(',');
 
 #ifdef ENABLE_ENC_CLASS
-    float vs1 = E1.latest() * PI * d_wheel * 3.6; // Vehicle speed in km/h
-    float vs2 = E2.latest() * PI * d_wheel * 3.6; // Vehicle speed in km/h
-    float vs3 = E3.latest() * PI * d_wheel * 3.6; // Vehicle speed in km/h
-    float vs4 = E4.latest() * PI * d_wheel * 3.6; // Vehicle speed in km/h
-
-    snprintf(buf, 48, "%.3f,%.3f,%.3f,%.3f", vs1, vs2, vs3, vs4);
+    R.fixed(TB_Params.actual_FL, 3).ch(',').fixed(TB_Params.actual_BL, 3).ch(',');  // Vehicle speed in km/h
+    R.fixed(TB_Params.actual_FR, 3).ch(',').fixed(TB_Params.actual_BR, 3);
 #else
+    const float d_wheel = WHEEL_DIAMETER;
     float vehicle_speed = s_encoder_rpm() * PI * d_wheel * 0.06; // Vehicle speed in km/h
 
-    snprintf(buf, 48, "%.3f,%c", vehicle_speed, encoderForwards ? 'F' : 'B');
+    R.fixed(vehicle_speed, 3).ch(',').ch(encoderForwards ? 'F' : 'B');
+#endif
+#ifdef ENABLE_ROBOCLAW
+    R.ch(',').fixed(Claw_Telemetry.current_M1, 2).ch(',').fixed(Claw_Telemetry.current_M2, 2);
+    R.ch(',').fixed(Claw_Telemetry.temperature, 1).ch(',').fixed(Claw_Telemetry.battery, 1);
 #endif
-    s0.ui_print(buf);
 #endif
 
     s0.ui();
@@ -421,36 +608,23 @@ public:
 #endif
 #ifdef APP_MOTORCONTROL
     s2.update(); // important: housekeeping
+    s_roboclaw_update(); // important: housekeeping
 #endif
 #ifdef ENABLE_GPS
-    if (gps->available()) {
-      gps->read();
-      if (gps->newNMEAreceived()) {
-        if (gps->parse(gps->lastNMEA())) {
-          if (reporting() && report > 100000) {
-            report = 0;
-            generate_report();
-          }
-        }
+    if (nmea.drain(Serial3)) { // parse everything received, as it arrives; true if an RMC or GGA sentence is complete
+      if (reporting() && report > 100000) {
+        report = 0;
+        generate_report();
       }
     }
 #endif
 #ifdef ENABLE_JOYWING
     if (J->tick()) { // returns true if Joystick communication sequence complete
       if (J->changes()) {
-        String joy("x=");
-        joy += String(J->x()) + String("; y=") + String(J->y()) + String("; b=");
-        if (J->up())     joy += 'u';
-        if (J->down())   joy += 'd';
-        if (J->left())   joy += 'l';
-        if (J->right())  joy += 'r';
-        if (J->select()) joy += 's';
         if (Serial) {
-          Serial.println(joy);
-        }
-        if (lora) {
-          lora->command_print(joy.c_str());
+          Serial.println(joy_status());
         }
+        bJoyChanged = true;
       }
     }
 #endif
@@ -477,10 +651,11 @@ void setup() {
   s_roboclaw_init(); // Setup RoboClaw
 
 #ifdef ENABLE_ENC_CLASS
-  E1.init(E1_ChA, E1_ChB, ENCODER_PPR, false); // set up encoder 1
-  E2.init(E2_ChA, E2_ChB, ENCODER_PPR, false); // set up encoder 2
-  E3.init(E3_ChA, E3_ChB, ENCODER_PPR, false); // set up encoder 3
-  E4.init(E4_ChA, E4_ChB, ENCODER_PPR, false); // set up encoder 4
+  {
+    const int wheels[] = ENCODER_WHEELS;
+    const int signs[]  = ENCODER_SIGNS;
+    Encoders.init(ENCODER_PPR, wheels, signs); // set up encoders
+  }
 #else
   s_encoder_init();     // Setup encoders
 #endif
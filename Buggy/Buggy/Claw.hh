@@ -30,7 +30,7 @@ struct tb_params {
 } TB_Params = { 5.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0 };
 
 #ifdef ENABLE_ROBOCLAW
-#include <RoboClaw.h>
+#include "ClawLink.hh"
 
 /* Motor Setup:
    (RoboClaw) S1 > (Uno etc) 11
@@ -56,18 +56,21 @@ static SoftwareSerial * config_serial() {
 }
 #endif // RoboClaw serial setup
 
-RoboClaw roboclaw(config_serial(), 10000);
+ClawLink claw(config_serial()); // packet serial, without blocking
 #endif
 
 static bool s_claw_writable = false;
 
 static bool s_roboclaw_init() {
-  const uint8_t address = 0x80;
 #ifdef ENABLE_ROBOCLAW
-  roboclaw.begin(38400);
-  bool bM1 = roboclaw.ForwardM1(address, 0);
-  bool bM2 = roboclaw.ForwardM2(address, 0);
-  s_claw_writable = bM1 && bM2;
+  config_serial()->begin(CLAW_BAUD);
+
+  claw.reset(); // stop both motors, and wait (here only) for the RoboClaw to acknowledge
+  elapsedMicros wait;
+  while (claw.busy() && (wait < 2 * CLAW_TIMEOUT)) {
+    claw.tick();
+  }
+  s_claw_writable = claw.connected();
 #endif
   if (!s_claw_writable) {
     Serial.println("RoboClaw not connected - disabling motor control.");
@@ -75,71 +78,171 @@ static bool s_roboclaw_init() {
   return s_claw_writable;
 }
 
-static int M1_actual = 0;
+static int M1_actual = 0; // as acknowledged by the RoboClaw
 static bool M1_enable = true;
 
-static void s_roboclaw_set_M1(int M1) {
-  const uint8_t address = 0x80;
-  bool bSuccess = false;
+static int M2_actual = 0;
+static bool M2_enable = true;
+
+/* Set both motors, -127..127; the command is sent, in a single packet, by s_roboclaw_update()
+ */
+static void s_roboclaw_set(int M1, int M2) {
   if (!M1_enable) M1 = 0;
+  if (!M2_enable) M2 = 0;
+
+  if (M1 < -127) {
+    M1 = -127;
+  } else if (M1 > 127) {
+    M1 = 127;
+  }
+  if (M2 < -127) {
+    M2 = -127;
+  } else if (M2 > 127) {
+    M2 = 127;
+  }
 #ifdef ENABLE_ROBOCLAW
-//Serial.println(M1);
-  if (M1 < 0) {
-    if (M1 < -127) {
-      M1 = -127;
-    }
-    if (s_claw_writable && (M1 != M1_actual))
-      bSuccess = roboclaw.BackwardM1(address, (uint8_t) (-M1));
-  } else {
-    if (M1 > 127) {
-      M1 = 127;
-    }
-    if (s_claw_writable && (M1 != M1_actual))
-      bSuccess = roboclaw.ForwardM1(address, (uint8_t) M1);
+  if (s_claw_writable) {
+    claw.duty(M1, M2);
   }
 #endif
-  if (bSuccess) M1_actual = M1;
 }
 
-static int M2_actual = 0;
-static bool M2_enable = true;
+struct claw_telemetry {
+  float current_M1;  // motor currents in A
+  float current_M2;
+  float temperature; // controller temperature in degrees C
+  float battery;     // main battery in V
+  unsigned long error; // error & warning bits
+  unsigned long updated; // millis() at the latest reply
+} Claw_Telemetry = { 0.0, 0.0, 0.0, 0.0, 0, 0 };
 
-static void s_roboclaw_set_M2(int M2) {
-  const uint8_t address = 0x80;
-  bool bSuccess = false;
-  if (!M2_enable) M2 = 0;
 #ifdef ENABLE_ROBOCLAW
-//Serial.println(M2);
-  if (M2 < 0) {
-    if (M2 < -127) {
-      M2 = -127;
+/* ClawTelemetry polls the RoboClaw in the background, one read at a time, and only when no other read is
+ * waiting, so that a motor command is never queued behind more than the read in progress. Reads are paid
+ * for from a bus-time budget that accrues at CLAW_TELEMETRY_BUDGET microseconds per second; the motor
+ * currents are read every other time, and battery, temperature & error status in turn in between.
+ */
+class ClawTelemetry : public ClawLink::Responder {
+private:
+  struct Read {
+    uint8_t command;
+    uint8_t length;
+  };
+  static constexpr Read s_sequence[] = {
+    { ClawLink::cc_GetCurrents,    4 },
+    { ClawLink::cc_GetMainBattery, 2 },
+    { ClawLink::cc_GetCurrents,    4 },
+    { ClawLink::cc_GetTemperature, 2 },
+    { ClawLink::cc_GetCurrents,    4 },
+    { ClawLink::cc_GetError,       4 }
+  };
+  static const int s_sequence_length = sizeof(s_sequence) / sizeof(s_sequence[0]);
+
+  unsigned long m_credit; // bus time available, in microseconds
+  unsigned long m_last;   // micros() at the last poll()
+  int m_next;
+
+  static inline int16_t s_int16(const uint8_t * data) {
+    return (int16_t) (((uint16_t) data[0] << 8) | data[1]);
+  }
+
+public:
+  ClawTelemetry() :
+    m_credit(0),
+    m_last(0),
+    m_next(0)
+  {
+    claw.responder(this);
+  }
+
+  virtual ~ClawTelemetry() {
+    // ...
+  }
+
+  void poll() {
+    unsigned long now = micros();
+    unsigned long elapsed = now - m_last;
+
+    if (elapsed >= 1000) { // accrue credit a millisecond or more at a time
+      m_last = now;
+      if (elapsed > 100000) {
+        elapsed = 100000;
+      }
+      m_credit += elapsed * (CLAW_TELEMETRY_BUDGET / 1000) / 1000;
+      if (m_credit > CLAW_TELEMETRY_BUDGET / 10) { // don't save up more than a tenth of a second's worth
+        m_credit = CLAW_TELEMETRY_BUDGET / 10;
+      }
     }
-    if (s_claw_writable && (M2 != M2_actual))
-      bSuccess = roboclaw.BackwardM2(address, (uint8_t) (-M2));
-  } else {
-    if (M2 > 127) {
-      M2 = 127;
+    if (!s_claw_writable || claw.queued()) {
+      return;
+    }
+    const Read & R = s_sequence[m_next];
+    unsigned long cost = ClawLink::bus_time(2 + R.length + 2);
+
+    if ((m_credit >= cost) && claw.read(R.command, R.length)) {
+      m_credit -= cost;
+      if (++m_next == s_sequence_length) {
+        m_next = 0;
+      }
     }
-    if (s_claw_writable && (M2 != M2_actual))
-      bSuccess = roboclaw.ForwardM2(address, (uint8_t) M2);
   }
+
+  virtual void claw_reply(int command, const uint8_t * data, int length) {
+    switch (command) {
+    case ClawLink::cc_GetCurrents:
+      Claw_Telemetry.current_M1 = (float) s_int16(data)     / 100.0f;
+      Claw_Telemetry.current_M2 = (float) s_int16(data + 2) / 100.0f;
+      break;
+    case ClawLink::cc_GetMainBattery:
+      Claw_Telemetry.battery = (float) (uint16_t) s_int16(data) / 10.0f;
+      break;
+    case ClawLink::cc_GetTemperature:
+      Claw_Telemetry.temperature = (float) s_int16(data) / 10.0f;
+      break;
+    case ClawLink::cc_GetError:
+      Claw_Telemetry.error = ((unsigned long) (uint16_t) s_int16(data) << 16) | (uint16_t) s_int16(data + 2);
+      break;
+    default:
+      return;
+    }
+    Claw_Telemetry.updated = millis();
+  }
+};
+
+constexpr ClawTelemetry::Read ClawTelemetry::s_sequence[];
+
+ClawTelemetry claw_poll;
+#endif
+
+/* RoboClaw housekeeping: send & receive without blocking, and poll for telemetry; call as often as possible
+ */
+static void s_roboclaw_update() {
+#ifdef ENABLE_ROBOCLAW
+  claw_poll.poll();
+  claw.tick();
+  M1_actual = claw.M1();
+  M2_actual = claw.M2();
 #endif
-  if (bSuccess) M2_actual = M2;
 }
 
+#include "PID.hh"
+
+#ifdef ENABLE_PID_FIXED
+#include "Fixed.hh"
+typedef Fixed control_t; // no FPU: run the controllers in Q16.16
+#else
+typedef float control_t;
+#endif
+
+/* The motor controllers compute the motor commands only; the commands are sent to the RoboClaw
+ * separately, so that the control loop can run from an interrupt (see Control.hh)
+ */
 class MC {
 private:
-  void (*m_set)(int M);
-
-  float kmh_error_old;
-  float kmh_error_integral;
+  PID<control_t> m_pid;
 
 public:
-  MC(void (*set)(int M)) :
-    m_set(set),
-    kmh_error_old(0),
-    kmh_error_integral(0)
-  {
+  MC() {
     // ...
   }
 
@@ -147,49 +250,44 @@ public:
     // ...
   }
 
-  /* Working in km/h, and time interval in milliseconds
+  /* Working in km/h, and time interval in milliseconds; returns the motor command
    */
-  void update(float kmh_target, float kmh_actual, float dt_ms) {
-    float kmh_error = kmh_target - kmh_actual;
-    float error_difference = (kmh_error - kmh_error_old) / dt_ms;
-
-    kmh_error_integral += ((kmh_error + kmh_error_old) / 2) * dt_ms;
-    kmh_error_old = kmh_error;
-
-    float pwm_estimate = MC_Params.P * kmh_error
-                       + MC_Params.I * kmh_error_integral
-                       + MC_Params.D * error_difference;
- // Serial.print(pwm_estimate);
-    (*m_set) ((int) pwm_estimate);
+  int update(control_t kmh_target, control_t kmh_actual, float dt_ms) {
+    m_pid.tune(MC_Params.P, MC_Params.I, MC_Params.D, dt_ms);
+
+    control_t pwm_estimate = m_pid.update(kmh_target - kmh_actual);
+ // Serial.print((float) pwm_estimate);
+    return (int) pwm_estimate;
   }
 };
 
-MC MC_Left(&s_roboclaw_set_M2);  // M2 on the left
-MC MC_Right(&s_roboclaw_set_M1); // M1 on the right
+MC MC_Left;  // M2 on the left
+MC MC_Right; // M1 on the right
 
-void s_buggy_update(float dt_ms) {
+void s_buggy_update(float dt_ms, int & M1, int & M2) {
   /* We need two PID control systems: this one for the Track Buggy speed, and a separate one for each motor speed
    */
-  static float kmh_error_old = 0;
-  static float kmh_error_integral = 0;
+  static PID<control_t> pid;
 
-  float kmh_error = TB_Params.target - TB_Params.actual;
-  float error_difference = (kmh_error - kmh_error_old) / dt_ms;
+  pid.tune(TB_Params.P, TB_Params.I, TB_Params.D, dt_ms);
 
-  kmh_error_integral += ((kmh_error + kmh_error_old) / 2) * dt_ms;
-  kmh_error_old = kmh_error;
+  /* Convert the speeds once, here; from here on, everything is in control_t
+   */
+  control_t actual    = control_t(TB_Params.actual);
+  control_t actual_BL = control_t(TB_Params.actual_BL);
+  control_t actual_FR = control_t(TB_Params.actual_FR);
 
-  float pwm_estimate = TB_Params.P * kmh_error
-                     + TB_Params.I * kmh_error_integral
-                     + TB_Params.D * error_difference;
+  control_t pwm_estimate = pid.update(control_t(TB_Params.target) - actual);
 
   /* Some slip between the powered wheels and the rails is inevitable; need to control it, however
    */
   if (TB_Params.slip > 0) { // If slip is set to zero, don't apply any limits
-    if (pwm_estimate > TB_Params.actual + TB_Params.slip) {
-      pwm_estimate = TB_Params.actual + TB_Params.slip;
-    } else if (pwm_estimate < TB_Params.actual - TB_Params.slip) {
-      pwm_estimate = TB_Params.actual - TB_Params.slip;
+    control_t slip = control_t(TB_Params.slip);
+
+    if (pwm_estimate > actual + slip) {
+      pwm_estimate = actual + slip;
+    } else if (pwm_estimate < actual - slip) {
+      pwm_estimate = actual - slip;
     }
   }
 
@@ -197,9 +295,9 @@ void s_buggy_update(float dt_ms) {
    * If, also, TB_Params.P/I/D = 1/0/0, and TB_Params.slip = 0 (to disable), then 
    * pwm_estimate = TB_Params.target and the pure motor response can be recorded.
    */
-  MC_Left.update(pwm_estimate, TB_Params.actual_BL, dt_ms);
+  M2 = MC_Left.update(pwm_estimate, actual_BL, dt_ms);
 //Serial.print(' ');
-  MC_Right.update(pwm_estimate, TB_Params.actual_FR, dt_ms);
+  M1 = MC_Right.update(pwm_estimate, actual_FR, dt_ms);
 //Serial.println();
 }
 
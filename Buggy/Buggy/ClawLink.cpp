@@ -0,0 +1,185 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#include "config.hh"
+#ifdef ENABLE_ROBOCLAW
+
+#include "ClawLink.hh"
+
+uint16_t ClawLink::s_crc(uint16_t crc, const uint8_t * bytes, int length) {
+  while (length--) {
+    crc ^= (uint16_t) *bytes++ << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+ClawLink::ClawLink(Stream * serial) :
+  m_serial(serial),
+  m_responder(0),
+  m_rx_count(0),
+  m_sent(0),
+  m_target_M1(0),
+  m_target_M2(0),
+  m_sent_M1(0),
+  m_sent_M2(0),
+  m_M1(0),
+  m_M2(0),
+  m_bBusy(false),
+  m_bDuty(false),
+  m_bKnown(false),
+  m_bConnected(false)
+{
+  clear();
+}
+
+void ClawLink::clear() {
+  m_stats.count = 0;
+  m_stats.timeouts = 0;
+  m_stats.errors = 0;
+  m_stats.latency_min = 0;
+  m_stats.latency_max = 0;
+  m_stats.latency_sum = 0;
+}
+
+void ClawLink::reset() {
+  m_queue.clear();
+  m_bBusy = false;
+
+  m_target_M1 = 0;
+  m_target_M2 = 0;
+  m_bDuty = true;
+  m_bKnown = false;
+}
+
+void ClawLink::duty(int M1, int M2) {
+  m_target_M1 = M1;
+  m_target_M2 = M2;
+
+  bool bSending = m_bBusy && (m_current.tx[1] == cc_DutyM1M2) && (m_sent_M1 == M1) && (m_sent_M2 == M2);
+
+  m_bDuty = !bSending && (!m_bKnown || (M1 != m_M1) || (M2 != m_M2)); // a failed command is re-sent by complete()
+}
+
+bool ClawLink::read(int command, int length) {
+  if (length + 2 > CLAW_REPLY_MAX) {
+    return false;
+  }
+  Transaction T;
+  T.tx[0] = CLAW_ADDRESS;
+  T.tx[1] = (uint8_t) command;
+  T.tx_length = 2;
+  T.rx_length = (uint8_t) (length + 2);
+
+  return m_queue.push(T);
+}
+
+void ClawLink::send() {
+  Transaction & T = m_current;
+
+  if (m_bDuty) { // the motor command goes first
+    m_bDuty = false;
+
+    m_sent_M1 = m_target_M1;
+    m_sent_M2 = m_target_M2;
+
+    int16_t d1 = (int16_t) ((long) m_sent_M1 * 32767 / 127);
+    int16_t d2 = (int16_t) ((long) m_sent_M2 * 32767 / 127);
+
+    T.tx[0] = CLAW_ADDRESS;
+    T.tx[1] = cc_DutyM1M2;
+    T.tx[2] = (uint8_t) ((uint16_t) d1 >> 8);
+    T.tx[3] = (uint8_t) d1;
+    T.tx[4] = (uint8_t) ((uint16_t) d2 >> 8);
+    T.tx[5] = (uint8_t) d2;
+
+    uint16_t crc = s_crc(0, T.tx, 6);
+    T.tx[6] = (uint8_t) (crc >> 8);
+    T.tx[7] = (uint8_t) crc;
+
+    T.tx_length = 8;
+    T.rx_length = 1;
+  } else if (!m_queue.pop(T)) {
+    return;
+  }
+
+  while (m_serial->available()) { // anything left over belongs to an earlier transaction
+    m_serial->read();
+  }
+  m_serial->write(T.tx, T.tx_length); // fits in the UART's transmit buffer, so doesn't block
+
+  m_sent = micros();
+  m_rx_count = 0;
+  m_bBusy = true;
+}
+
+void ClawLink::complete(bool bSuccess) {
+  m_bBusy = false;
+  m_bConnected = bSuccess;
+
+  ++m_stats.count;
+
+  if (bSuccess) {
+    unsigned long latency = micros() - m_sent;
+
+    if (!m_stats.latency_sum || latency < m_stats.latency_min) {
+      m_stats.latency_min = latency;
+    }
+    if (latency > m_stats.latency_max) {
+      m_stats.latency_max = latency;
+    }
+    m_stats.latency_sum += latency;
+  }
+
+  if (m_current.tx[1] == cc_DutyM1M2) {
+    if (bSuccess) {
+      m_M1 = m_sent_M1;
+      m_M2 = m_sent_M2;
+      m_bKnown = true;
+    }
+    if (!m_bKnown || (m_target_M1 != m_M1) || (m_target_M2 != m_M2)) {
+      m_bDuty = true; // failed, or superseded
+    }
+  } else if (bSuccess && m_responder) {
+    m_responder->claw_reply(m_current.tx[1], m_rx, m_current.rx_length - 2);
+  }
+}
+
+void ClawLink::tick() {
+  if (!m_bBusy) {
+    send();
+    if (!m_bBusy) {
+      return;
+    }
+  }
+
+  while ((m_rx_count < m_current.rx_length) && m_serial->available()) {
+    m_rx[m_rx_count++] = (uint8_t) m_serial->read();
+  }
+
+  if (m_rx_count == m_current.rx_length) {
+    bool bSuccess;
+
+    if (m_current.tx[1] == cc_DutyM1M2) {
+      bSuccess = (m_rx[0] == 0xFF);
+    } else {
+      int length = m_current.rx_length - 2;
+      uint16_t crc = s_crc(s_crc(0, m_current.tx, m_current.tx_length), m_rx, length);
+
+      bSuccess = (m_rx[length] == (uint8_t) (crc >> 8)) && (m_rx[length + 1] == (uint8_t) crc);
+    }
+    if (!bSuccess) {
+      ++m_stats.errors;
+    }
+    complete(bSuccess);
+  } else if (micros() - m_sent > CLAW_TIMEOUT) {
+    ++m_stats.timeouts;
+    complete(false);
+  }
+}
+
+#endif // ENABLE_ROBOCLAW
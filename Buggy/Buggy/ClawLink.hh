@@ -0,0 +1,141 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_ClawLink_hh
+#define cariot_ClawLink_hh
+
+#include "Ring.hh"
+
+#define CLAW_ADDRESS    0x80  // packet serial address of the RoboClaw
+#define CLAW_BAUD       38400 // packet serial baud rate
+#define CLAW_TIMEOUT    10000 // microseconds to wait for a complete reply
+#define CLAW_QUEUE      8     // read transactions waiting to be sent; must be a power of two
+#define CLAW_PACKET_MAX 8     // address, command, up to four data bytes, CRC
+#define CLAW_REPLY_MAX  8     // up to six data bytes, CRC
+
+/* ClawLink talks RoboClaw packet serial without blocking: tick() sends one transaction at a time and then
+ * collects its reply byte by byte, as it arrives, until the reply is complete or CLAW_TIMEOUT has passed.
+ *
+ * Both motors are set by a single DutyM1M2 packet. Motor commands aren't queued: duty() replaces any command
+ * not yet sent, and a command is only sent if it differs from the last one acknowledged; one that fails is
+ * sent again. The motor command, if any, goes before any queued read.
+ *
+ * Packets are address, command, data and a CRC16 (CCITT, big-endian); a write is acknowledged with 0xFF,
+ * and a read returns its data followed by the CRC of the request and the data together.
+ */
+class ClawLink {
+public:
+  enum Command {
+    cc_GetMainBattery = 24, // 2 bytes: volts x 10
+    cc_DutyM1M2       = 34, // write: M1, M2 duty, signed 16-bit each
+    cc_GetCurrents    = 49, // 4 bytes: M1, M2 amps x 100, signed 16-bit each
+    cc_GetTemperature = 82, // 2 bytes: degrees C x 10
+    cc_GetError       = 90  // 4 bytes: error & warning bits
+  };
+
+  class Responder {
+  public:
+    virtual void claw_reply(int command, const uint8_t * data, int length) = 0; // a read that passed the CRC
+
+    virtual ~Responder() { }
+  };
+
+  struct Stats {       // transactions since the last clear(); latency is from the request to the end of the reply, in microseconds
+    unsigned long count;
+    unsigned long timeouts;
+    unsigned long errors; // bad CRC, or a write not acknowledged
+    unsigned long latency_min;
+    unsigned long latency_max;
+    unsigned long latency_sum; // over successful transactions
+  };
+
+private:
+  struct Transaction {
+    uint8_t tx[CLAW_PACKET_MAX];
+    uint8_t tx_length;
+    uint8_t rx_length; // bytes expected in reply
+  };
+
+  Stream *    m_serial;
+  Responder * m_responder;
+
+  Ring<Transaction, CLAW_QUEUE> m_queue;
+
+  Transaction m_current;
+
+  uint8_t m_rx[CLAW_REPLY_MAX];
+  int     m_rx_count;
+
+  unsigned long m_sent; // micros() when the current transaction was sent
+
+  int m_target_M1;      // latest motor command
+  int m_target_M2;
+  int m_sent_M1;        // motor command in the current transaction
+  int m_sent_M2;
+  int m_M1;             // last motor command acknowledged
+  int m_M2;
+
+  Stats m_stats;
+
+  bool m_bBusy;         // waiting for a reply
+  bool m_bDuty;         // motor command to send
+  bool m_bKnown;        // m_M1 & m_M2 are what the RoboClaw has
+  bool m_bConnected;    // the last transaction succeeded
+
+  static uint16_t s_crc(uint16_t crc, const uint8_t * bytes, int length);
+
+  void send();
+  void complete(bool bSuccess);
+
+public:
+  ClawLink(Stream * serial);
+
+  ~ClawLink() {
+    // ...
+  }
+
+  inline void responder(Responder * R) {
+    m_responder = R;
+  }
+
+  /* Forget anything queued or in progress, and command both motors to stop
+   */
+  void reset();
+
+  /* Set both motors, -127..127
+   */
+  void duty(int M1, int M2);
+
+  /* Queue a read of a given number of data bytes; returns false if the queue is full
+   */
+  bool read(int command, int length);
+
+  void tick();
+
+  inline bool busy() const { // a transaction is in progress or waiting
+    return m_bBusy || m_bDuty || !m_queue.is_empty();
+  }
+  inline bool queued() const { // reads waiting to be sent
+    return !m_queue.is_empty();
+  }
+  inline bool connected() const {
+    return m_bConnected;
+  }
+  inline int M1() const { return m_M1; }
+  inline int M2() const { return m_M2; }
+
+  /* Bus time of a transaction of a given number of bytes, request & reply together, in microseconds
+   */
+  static inline unsigned long bus_time(int bytes) {
+    return (unsigned long) bytes * 10000000UL / CLAW_BAUD; // 10 bits per byte
+  }
+
+  inline const Stats & stats() const {
+    return m_stats;
+  }
+  void clear();
+};
+
+#endif /* !cariot_ClawLink_hh */
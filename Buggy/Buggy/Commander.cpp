@@ -63,9 +63,18 @@ float Commander::unpack754_32(uint32_t i) {
   return (i & signbit) ? (-result) : result;
 }
 
-Commander::Commander(Responder * R) :
+Commander::Commander(Responder * R, int id) :
   m_Responder(R),
+  m_id(id),
   m_length(0),
+  m_text(0),
+  m_skip(0),
+  m_intercept(0),
+  m_bIntercept(false),
+  m_code(0),
+  m_digits(0),
+  m_value(0),
+  m_frame_length(0),
   m_bUI(false),
   m_bSOL(true)
 {
@@ -85,26 +94,65 @@ void Commander::update() {
   // ...
 }
 
+void Commander::bridge(const char * intercept) {
+  m_intercept = intercept;
+  m_bIntercept = false;
+  m_code = 0;
+  m_frame_length = 0;
+  m_length = 0;
+  m_text = 0;
+  m_skip = 0;
+}
+
+int Commander::format(char * buf, char code, unsigned long value) {
+  return snprintf(buf, 16, "%c%lu,", code, value);
+}
+
 void Commander::command_send(char code, unsigned long value) {
+  char buf[16];
+  command_frame(buf, format(buf, code, value));
+}
+
+void Commander::command_frame(const char * frame, int length) {
   if (m_bUI) {
     ui(); // line-break for readability
   }
-
-  char buf[16];
-  snprintf(buf, 16, "%c%lu,", code, value);
-  m_fifo.write(buf, strlen(buf));
+  if (m_fifo.availableToWrite() < length) { // keep frames whole; drop any that doesn't fit
+    return;
+  }
+  m_fifo.write(frame, length);
 
   m_bSOL = false;
 }
 
 void Commander::command_print(const char * str) {
-  if (str) {
-    const char * ptr = str;
-    while (*ptr) {
-      command_send('p', (unsigned long) (*ptr++));
+  if (m_bUI) {
+    ui(); // line-break for readability
+  }
+  if (m_fifo.availableToWrite() < 2) { // no room for the end of the string; skip the whole message
+    return;
+  }
+
+  size_t length = str ? strlen(str) : 0;
+
+  while (length) {
+    int count = (length > COMMANDER_TEXT_MAX) ? COMMANDER_TEXT_MAX : (int) length;
+
+    char buf[8];
+    int header = snprintf(buf, 8, "$%d,", count);
+
+    if (m_fifo.availableToWrite() < header + count + 2) { // keep frames whole; leave room for the end
+      break;
     }
+    m_fifo.write(buf, header);
+    m_fifo.write(str, count);
+
+    str += count;
+    length -= count;
   }
-  command_send('p');
+  m_fifo.write("$,", 2);
+
+  m_bSOL = false;
 }
 
 const char * Commander::eol() {
@@ -112,17 +160,21 @@ const char * Commander::eol() {
   return str_eol;
 }
 
+void Commander::ui_break() {
+  const char * str = eol();
+  int len = strlen(str);
+  if (m_fifo.availableToWrite() >= len) { // don't add the end-of-line unless you can add the whole string
+    m_fifo.write(str, len);
+  }
+  m_bUI = false;
+  m_bSOL = true;
+}
+
 void Commander::ui(char c) {
   bool bPrintable = isprint(c);
 
   if (!m_bSOL && ((!c && m_bUI) || (bPrintable && !m_bUI))) { // line-break for readability
-    const char * str = eol();
-    int len = strlen(str);
-    if (m_fifo.availableToWrite() >= len) { // don't add the end-of-line unless you can add the whole string
-      m_fifo.write(str, len);
-    }
-    m_bUI = false;
-    m_bSOL = true;
+    ui_break();
   }
   if (bPrintable) { // append
     m_fifo.push(c);
@@ -131,6 +183,43 @@ void Commander::ui(char c) {
   }
 }
 
+void Commander::ui_write(const char * str, size_t length) {
+  const char * end = str + length;
+
+  while (str < end) {
+    const char * run = str;
+    while ((str < end) && isprint(*str)) {
+      ++str;
+    }
+    if (str > run) { // append a run of printable characters
+      if (!m_bSOL && !m_bUI) { // line-break for readability
+        ui_break();
+      }
+      m_fifo.write(run, str - run);
+      m_bUI = true;
+      m_bSOL = false;
+    }
+    while ((str < end) && !isprint(*str)) { // skip anything else
+      ++str;
+    }
+  }
+}
+
+int Commander::ui_span(char *& span) {
+  if (!m_bSOL && !m_bUI) { // line-break for readability
+    ui_break();
+  }
+  return m_fifo.reserve_span(span);
+}
+
+void Commander::ui_commit(int count) {
+  if (count > 0) {
+    m_fifo.commit(count);
+    m_bUI = true;
+    m_bSOL = false;
+  }
+}
+
 void Commander::notify(const char * str) {
   if (m_Responder) {
     m_Responder->notify(this, str);
@@ -143,8 +232,24 @@ void Commander::command(char code, unsigned long value) {
   }
 }
 
+void Commander::text(const char * str, int length) {
+  if (m_Responder) {
+    m_Responder->text(this, str, length);
+  }
+}
+
+void Commander::relay(const char * bytes, int length) {
+  if (m_Responder && length) {
+    m_Responder->relay(this, bytes, length);
+  }
+}
+
 void Commander::push(char next) {
-  if ((next >= 'A' && next <= 'Z') || (next >= 'a' && next <= 'z')) {
+  if (m_text || m_skip) { // inside a text frame
+    push(&next, 1);
+    return;
+  }
+  if ((next >= 'A' && next <= 'Z') || (next >= 'a' && next <= 'z') || (next == '$')) {
     m_buffer[0] = next;
     m_length = 1;
   } else if (next >= '0' && next <= '9') {
@@ -154,7 +259,17 @@ void Commander::push(char next) {
       m_length = 0;
     }
   } else if (next == ',') {
-    if (m_length > 1) {
+    if (m_length && (m_buffer[0] == '$')) { // text frame header
+      m_buffer[m_length] = 0;
+      unsigned long length = strtoul(m_buffer+1, 0, 10);
+      if (!length) {
+        text(0, 0); // end of string
+      } else if (length <= COMMANDER_TEXT_MAX) {
+        m_text = (int) length;
+      } else { // too long; the content is discarded rather than parsed as commands
+        m_skip = length;
+      }
+    } else if (m_length > 1) {
       m_buffer[m_length] = 0;
       command(m_buffer[0], strtoul(m_buffer+1, 0, 10));
     } else if (m_length == 1) {
@@ -165,3 +280,128 @@ void Commander::push(char next) {
     m_length = 0;
   }
 }
+
+void Commander::push(const char * bytes, int length) {
+  if (m_intercept) {
+    bridge(bytes, length);
+    return;
+  }
+  const char * end = bytes + length;
+
+  while (bytes < end) {
+    if (m_skip) {
+      unsigned long count = end - bytes;
+      if (count > m_skip) {
+        count = m_skip;
+      }
+      m_skip -= count;
+      bytes += count;
+    } else if (m_text) { // hand over as much of the text frame as we have, in place
+      int count = end - bytes;
+      if (count > m_text) {
+        count = m_text;
+      }
+      m_text -= count;
+      text(bytes, count);
+      bytes += count;
+    } else {
+      push(*bytes++);
+    }
+  }
+}
+
+/* Frames to relay are passed on in place, as many whole frames at a time as are contiguous in the span;
+ * only a frame split across spans is copied, to m_frame, so that it isn't relayed in pieces (which a full
+ * destination might cut short, or another source interleave)
+ */
+void Commander::bridge(const char * bytes, int length) {
+  const char * end = bytes + length;
+  const char * frame = bytes;   // start of the current frame; or of its remainder, if carried over
+  const char * run = bytes;     // whole frames not yet relayed: run .. run_end
+  const char * run_end = bytes;
+
+  while (bytes < end) {
+    bool bWhole = false; // a frame to relay ends here
+
+    if (m_skip) { // a text frame too long to accept; neither parsed nor relayed
+      unsigned long count = end - bytes;
+      if (count > m_skip) {
+        count = m_skip;
+      }
+      m_skip -= count;
+      bytes += count;
+      continue;
+    }
+    if (m_text) { // text frame content, as much of it as we have
+      int count = end - bytes;
+      if (count > m_text) {
+        count = m_text;
+      }
+      if (m_bIntercept) {
+        text(bytes, count);
+      }
+      m_text -= count;
+      bytes += count;
+
+      if (!m_text) {
+        bWhole = !m_bIntercept;
+        m_code = 0;
+      }
+    } else {
+      char c = *bytes++;
+
+      if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c == '$')) { // start of a frame
+        m_code = c;
+        m_digits = 0;
+        m_value = 0;
+        m_bIntercept = strchr(m_intercept, c);
+        m_frame_length = 0; // anything incomplete is dropped, as the receiver would ignore it
+        frame = bytes - 1;
+      } else if (!m_code) { // between frames
+        continue;
+      } else if ((c >= '0' && c <= '9') && (m_digits < 10)) {
+        m_value = m_value * 10 + (c - '0');
+        ++m_digits;
+      } else if (c == ',') {
+        if ((m_code == '$') && (m_value > COMMANDER_TEXT_MAX)) { // too long; the content is discarded
+          m_skip = m_value;
+          m_code = 0;
+          m_frame_length = 0;
+        } else if ((m_code == '$') && m_value) { // text frame header; the content follows
+          m_text = (int) m_value;
+        } else { // a command, or the end of a string
+          if (!m_bIntercept) {
+            bWhole = true;
+          } else if (m_code == '$') {
+            text(0, 0);
+          } else {
+            command(m_code, m_value);
+          }
+          m_code = 0;
+        }
+      } else {
+        m_code = 0;
+        m_frame_length = 0;
+      }
+    }
+    if (!bWhole) {
+      continue;
+    }
+    if (m_frame_length) { // the rest of a frame carried over, which can only be at the start of the span
+      memcpy(m_frame + m_frame_length, frame, bytes - frame);
+      relay(m_frame, m_frame_length + (int) (bytes - frame));
+      m_frame_length = 0;
+      run = bytes;
+    } else if (frame != run_end) { // not contiguous with the run so far
+      relay(run, run_end - run);
+      run = frame;
+    }
+    run_end = bytes;
+  }
+  relay(run, run_end - run);
+
+  if (m_code && !m_bIntercept) { // a frame to relay, continued in the next span
+    memcpy(m_frame + m_frame_length, frame, end - frame);
+    m_frame_length += end - frame;
+  }
+}
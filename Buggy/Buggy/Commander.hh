@@ -6,53 +6,107 @@
 #ifndef cariot_Commander_hh
 #define cariot_Commander_hh
 
-#include "FIFO.hh"
+#include "Ring.hh"
 
 class Commander {
 public:
   static float unpack754_32(uint32_t i);
   static uint32_t pack754_32(float f);
 
+  enum Transport { // integer IDs, e.g., for routing tables
+    ct_Serial0 = 0,
+    ct_Serial1,
+    ct_Serial2,
+    ct_Bluetooth,
+    ct_LoRa,
+    ct_Count
+  };
+
+  static int format(char * buf, char code, unsigned long value); // buf must have space for 16; returns length
+
   class Responder {
   public:
     virtual void notify(Commander * C, const char * str) = 0;
     virtual void command(Commander * C, char code, unsigned long value) = 0;
 
+    /* Text received from a command_print(), in one or more fragments pointing into the receive buffer;
+     * a call with length 0 marks the end of the string
+     */
+    virtual void text(Commander * C, const char * str, int length) = 0;
+
+    /* In bridge mode, received frames to be relayed as is; one or more whole frames, as received, though
+     * text may arrive as several frames
+     */
+    virtual void relay(Commander * C, const char * bytes, int length) = 0;
+
     virtual ~Responder() { }
   };
 
 protected:
   Responder * m_Responder;
-  FIFO<char> m_fifo;
+  int m_id;
+  Ring<char, COMMANDER_BUFSIZE> m_fifo;
 
 private:
   int m_length;
+  int m_text;        // bytes remaining in the current text frame
+  unsigned long m_skip; // bytes remaining in a text frame too long to accept, which are discarded
+  const char * m_intercept; // bridge mode: codes to parse rather than relay; 0 if not in bridge mode
+  bool m_bIntercept; // bridge mode: current frame is being parsed
+  char m_code;       // bridge mode: code of the current frame; 0 if between frames
+  int m_digits;      // bridge mode: digits in the current frame's header
+  unsigned long m_value; // bridge mode: value of those digits
+  int m_frame_length; // bridge mode: length of the frame carried over in m_frame
   char m_buffer[16]; // command receive buffer
+  char m_frame[COMMANDER_TEXT_MAX + 12]; // bridge mode: a frame to relay, carried over from one span to the next
   bool m_bUI;        // UI text mode
   bool m_bSOL;       // Start of line
 
 public:
-  Commander(Responder * R);
+  Commander(Responder * R, int id);
   virtual ~Commander();
   virtual const char * name() const; // override this method to provide ID
+  inline int id() const { return m_id; }
   virtual void update();             // override this method to manage IO streams
 
+  /* Bridge mode: received frames are passed to Responder::relay() as they are, except for those whose
+   * codes are listed in intercept, which are parsed as usual and not relayed; list '$' to have text frames
+   * delivered to Responder::text(). Incomplete frames, and text frames longer than COMMANDER_TEXT_MAX, are
+   * dropped. Call with 0 to switch off.
+   */
+  void bridge(const char * intercept);
+
   virtual void command_send(char code, unsigned long value = 0);
-  virtual void command_print(const char * str);
+  virtual void command_frame(const char * frame, int length); // whole frames, e.g., from format(); dropped if full
+  virtual void command_print(const char * str); // sent as text frames: "$<length>,<bytes>" ... "$,"
   virtual void ui(char c = 0);
+  virtual void ui_write(const char * str, size_t length); // equivalent to ui() for each character
   void ui_print(const char * str) {
-    if (str)
-      while(*str) {
-        ui(*str++);
-      }
+    if (str) {
+      ui_write(str, strlen(str));
+    }
   }
 
+  /* Zero-copy UI text (see Format.hh): ui_span() returns the longest run of free output space, which may
+   * be less than all of it if the space wraps around; fill it with printable characters only, then pass
+   * the number written to ui_commit(), and call ui_span() again for more. Returns zero if full.
+   */
+  virtual int ui_span(char *& span);
+  virtual void ui_commit(int count);
+
   virtual const char * eol();
 
+private:
+  void ui_break();
 protected:
   void notify(const char * str);
   void command(char code, unsigned long value);
+  void text(const char * str, int length);
   void push(char c);
+  void push(const char * bytes, int length); // parse a received span in place
+private:
+  void relay(const char * bytes, int length);
+  void bridge(const char * bytes, int length);
 };
 
 #endif /* !cariot_Commander_hh */
@@ -0,0 +1,193 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_Control_hh
+#define cariot_Control_hh
+
+#include "SeqLock.hh"
+
+/* Control runs the cascaded speed control - encoder sync, buggy PID, motor PIDs - at a fixed rate. With
+ * ENABLE_CONTROL_TIMER (Teensy), each cycle is an IntervalTimer interrupt, so that slow work in the main loop
+ * (RoboClaw transactions, GPS, reports) can't delay it; otherwise, step() is called from every_10ms().
+ * Either way, the PIDs are given the measured interval since the previous cycle, not the nominal one.
+ *
+ * The motor commands can't be sent from the interrupt, so each cycle posts them to a mailbox (a seqlock,
+ * written only by the control cycle) from which the main loop takes the latest with output().
+ *
+ * The encoder interrupts must be able to pre-empt the control interrupt, since Encoders.sync() waits for
+ * any snapshot update in progress; the control interrupt therefore has a lower priority than the pins.
+ */
+class Control {
+public:
+  static_assert(CONTROL_PERIOD >= 1000, "Control: CONTROL_PERIOD must be at least 1000us (1 kHz)");
+
+  struct Output {      // motor commands, -127..127
+    int M1;            // right
+    int M2;            // left
+    unsigned long cycle;
+  };
+
+  struct Jitter {      // interval between cycles, and how far it was from the period, in microseconds
+    unsigned long count;
+    unsigned long interval_min;
+    unsigned long interval_max;
+    unsigned long jitter_sum;
+    unsigned long jitter_max;
+    unsigned long run_max; // longest control cycle
+  };
+
+private:
+  SeqLock<Output> m_output;
+  SeqLock<Jitter> m_jitter;
+
+  unsigned long m_period;
+  unsigned long m_last;  // micros() at the start of the previous cycle
+  unsigned long m_cycle;
+  unsigned long m_taken; // last cycle taken by output()
+
+  volatile bool m_bClear;
+  bool m_bTimer;
+
+#ifdef ENABLE_CONTROL_TIMER
+  IntervalTimer m_timer;
+
+  static Control * s_control;
+
+  static void s_step() {
+    s_control->step();
+  }
+#endif
+
+  static inline unsigned long s_difference(unsigned long a, unsigned long b) {
+    return (a > b) ? (a - b) : (b - a);
+  }
+
+  void record(unsigned long interval, unsigned long run) {
+    Jitter & J = m_jitter.write_begin();
+
+    if (m_bClear) {
+      m_bClear = false;
+      J.count = 0;
+      J.jitter_sum = 0;
+      J.jitter_max = 0;
+      J.run_max = 0;
+    }
+    if (!J.count || interval < J.interval_min) {
+      J.interval_min = interval;
+    }
+    if (!J.count || interval > J.interval_max) {
+      J.interval_max = interval;
+    }
+    ++J.count;
+
+    unsigned long jitter = s_difference(interval, m_period);
+    J.jitter_sum += jitter;
+    if (jitter > J.jitter_max) {
+      J.jitter_max = jitter;
+    }
+    if (run > J.run_max) {
+      J.run_max = run;
+    }
+    m_jitter.write_end();
+  }
+
+public:
+  Control() :
+    m_period(CONTROL_PERIOD),
+    m_last(0),
+    m_cycle(0),
+    m_taken(0),
+    m_bClear(true),
+    m_bTimer(false)
+  {
+    // ...
+  }
+
+  ~Control() {
+    // ...
+  }
+
+  /* Start the control interrupt; returns false if there's no timer, in which case call step() regularly
+   */
+  bool begin() {
+    m_last = micros();
+#ifdef ENABLE_CONTROL_TIMER
+    s_control = this;
+    m_timer.priority(CONTROL_PRIORITY);
+    m_bTimer = m_timer.begin(s_step, CONTROL_PERIOD);
+#endif
+    m_period = m_bTimer ? CONTROL_PERIOD : 10000UL; // i.e., every_10ms()
+    return m_bTimer;
+  }
+  inline bool timed() const { // true if the control cycle is interrupt-driven
+    return m_bTimer;
+  }
+  inline unsigned long period() const {
+    return m_period;
+  }
+
+  /* One control cycle
+   */
+  void step() {
+    unsigned long start = micros();
+    unsigned long interval = start - m_last;
+    m_last = start;
+
+    if (!interval) {
+      return;
+    }
+    Encoders.sync();
+
+    const float scaling = PI * WHEEL_DIAMETER * 3.6;
+
+    TB_Params.actual_FL = Encoders.wheel(wh_FL) * scaling; // see ENCODER_WHEELS & ENCODER_SIGNS in Encoders.hh
+    TB_Params.actual_BL = Encoders.wheel(wh_BL) * scaling;
+    TB_Params.actual_FR = Encoders.wheel(wh_FR) * scaling;
+    TB_Params.actual_BR = Encoders.wheel(wh_BR) * scaling;
+
+    TB_Params.actual = (TB_Params.actual_FL + TB_Params.actual_BR) / 2.0; // the non-powered wheels
+
+#ifdef ENABLE_PID
+    int M1 = 0;
+    int M2 = 0;
+
+    s_buggy_update((float) interval / 1000.0f, M1, M2); // see Claw.hh
+
+    Output & O = m_output.write_begin();
+    O.M1 = M1;
+    O.M2 = M2;
+    O.cycle = ++m_cycle;
+    m_output.write_end();
+#endif
+
+    record(interval, micros() - start);
+  }
+
+  /* The latest motor commands; returns false if there's been no cycle since the last call
+   */
+  bool output(Output & O) {
+    m_output.read(O);
+    if (O.cycle == m_taken) {
+      return false;
+    }
+    m_taken = O.cycle;
+    return true;
+  }
+
+  /* Jitter since the last call to jitter_clear()
+   */
+  inline void jitter(Jitter & J) const {
+    m_jitter.read(J);
+  }
+  inline void jitter_clear() {
+    m_bClear = true;
+  }
+};
+
+#ifdef ENABLE_CONTROL_TIMER
+Control * Control::s_control = 0;
+#endif
+
+#endif /* !cariot_Control_hh */
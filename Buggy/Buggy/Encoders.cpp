@@ -6,88 +6,117 @@
 #include "config.hh"
 #ifdef ENABLE_ENC_CLASS
 
-#define BuildEncoder(EX) \
-  static void EX##_ch_A(); \
-  static void EX##_ch_B(); \
-  \
-  static float EX##_sync(unsigned long & last_elapsed, unsigned long & last_count); \
-  \
-  Encoder EX(EX##_ch_A, EX##_ch_B, EX##_sync); \
-  \
-  volatile static unsigned long EX##_count = 0; \
-  volatile static unsigned long EX##_delta = 0; \
-  volatile static float         EX##_sense = 1; \
-  \
-  static void EX##_ch_A() { \
-    EX##_delta = EX.timer; \
-    EX.timer = 0; \
-  \
-    EX##_sense = ((digitalRead(EX.ch_A_pin) == digitalRead(EX.ch_B_pin)) ? 1 : -1); \
-  \
-    ++EX##_count; \
-  } \
-  \
-  static void EX##_ch_B() { \
-    EX##_delta = EX.timer; \
-    EX.timer = 0; \
-  \
-    EX##_sense = ((digitalRead(EX.ch_A_pin) != digitalRead(EX.ch_B_pin)) ? 1 : -1); \
-  \
-    ++EX##_count; \
-  } \
-  \
-  static float EX##_sync(unsigned long & last_delta, unsigned long & last_count) { \
-    last_count = EX##_count; \
-    last_delta = EX##_delta; \
-  \
-    EX##_count = 0; \
-  \
-    return EX##_sense; \
-  }
-
 #include "Encoders.hh"
 
-BuildEncoder(E1)
-BuildEncoder(E2)
-BuildEncoder(E3)
-BuildEncoder(E4)
+const signed char Encoder::s_quadrature[16] = {
+   0, +1, -1,  2,
+  -1,  0,  2, +1,
+  +1,  2,  0, -1,
+   2, -1, +1,  0
+};
+
+Encoders_t Encoders;
+
+void Encoder::init(int pin_A, int pin_B, void (*edge_interrupt)()) {
+#if defined(TEENSYDUINO)
+  port_A = portInputRegister(pin_A); // Teensy 3: the pin's own bit-band register; Teensy 4: the GPIO port
+  port_B = portInputRegister(pin_B);
+#if defined(__IMXRT1062__)
+  mask_A = digitalPinToBitMask(pin_A);
+  mask_B = digitalPinToBitMask(pin_B);
+#else
+  mask_A = 1;
+  mask_B = 1;
+#endif
+#else
+  port_A = portInputRegister(digitalPinToPort(pin_A));
+  port_B = portInputRegister(digitalPinToPort(pin_B));
+  mask_A = digitalPinToBitMask(pin_A);
+  mask_B = digitalPinToBitMask(pin_B);
+#endif
 
-void Encoder::init(int pin_A, int pin_B, unsigned ppr, bool clockwise) {
-  cpr = 4 * (float) ppr;
+  pinMode(pin_A, INPUT_PULLUP);
+  pinMode(pin_B, INPUT_PULLUP);
 
-  sense = clockwise ? 1 : -1;
+  state = pins(); // starting state, so that the first edge isn't taken as illegal
 
-  ch_A_pin = pin_A;
-  ch_B_pin = pin_B;
+  attachInterrupt(digitalPinToInterrupt(pin_A), edge_interrupt, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(pin_B), edge_interrupt, CHANGE);
 
-  pinMode(ch_A_pin, INPUT_PULLUP);
-  attachInterrupt(digitalPinToInterrupt(ch_A_pin), ch_A_interrupt, CHANGE);
+  counts_us = 0;
 
-  pinMode(ch_B_pin, INPUT_PULLUP);
-  attachInterrupt(digitalPinToInterrupt(ch_B_pin), ch_B_interrupt, CHANGE);
+  m_history_count = 0;
+  m_last_time = 0;
 
-  rev_s = 0;
-  dsync = 0;
-  timer = 0;
+  m_quality.edges = 0;
+  m_quality.window = 0;
+  m_quality.age = 0;
+  m_quality.illegal = 0;
+  m_quality.dropped = 0;
 }
 
 void Encoder::sync() {
-  unsigned long dt = dsync; // how long since last sync()
-  dsync = 0;
-
-  unsigned long count;
-  unsigned long delta;
-  rev_s = sense * synchronise(delta, count);
-
-  if (count < 2) {
-    rev_s = 0; // call it: stopped
-  } else {
-    if (count > delta) {
-      rev_s *= 1E6 * ((float) count) / (cpr * (float) dt);
-    } else {
-      rev_s *= 1E6 / (cpr * (float) delta);
+  Edge E;
+  while (m_edges.pop(E)) { // any dropped edges are simply missing from the history
+    m_history[m_history_count++ & (ENCODER_HISTORY - 1)] = E;
+  }
+
+  /* The snapshot is read after draining the edges, so that it's at least as new as any edge in the history;
+   * an edge queued since then is simply picked up next time
+   */
+  Snapshot S;
+  m_snapshot.read(S); // no need to disable interrupts
+
+  unsigned long now = micros(); // after the snapshot, so never before its last edge
+
+  m_quality.illegal = S.illegal;
+  m_quality.dropped = S.dropped;
+  m_quality.age     = now - S.time;
+
+  if (S.time != m_last_time) { // new edges since the last sync; choose the start of the window
+    m_last_time = S.time;
+
+    const Edge * start = 0;
+    unsigned n = (m_history_count < ENCODER_HISTORY) ? m_history_count : ENCODER_HISTORY;
+
+    for (unsigned i = 1; i <= n; i++) {
+      const Edge & H = m_history[(m_history_count - i) & (ENCODER_HISTORY - 1)];
+      unsigned long span = S.time - H.time;
+
+      if (!span) {
+        continue; // i.e., the latest edge itself
+      }
+      if (span > ENCODER_WINDOW_MAX) {
+        if (!start && (span <= ENCODER_TIMEOUT)) {
+          start = &H; // slow; the previous edge is the best there is
+        }
+        break;
+      }
+      start = &H;
+
+      long counts = S.position - H.position;
+      if ((counts >= ENCODER_EDGES_MIN) || (counts <= -ENCODER_EDGES_MIN)) {
+        break;
+      }
+    }
+    if (start) {
+      long counts = S.position - start->position;
+      m_quality.edges  = (counts < 0) ? -counts : counts;
+      m_quality.window = S.time - start->time;
+      counts_us = (float) counts / (float) m_quality.window;
+    } else { // first edge after a stop: no earlier edge to measure from
+      m_quality.edges  = 1;
+      m_quality.window = 0;
+      counts_us = 0;
     }
   }
+
+  if (m_quality.age > ENCODER_TIMEOUT) {
+    counts_us = 0; // call it: stopped
+  } else if (m_quality.age && (fabsf(counts_us) * (float) m_quality.age > 1)) { // an edge is overdue; slowing down
+    counts_us = ((counts_us < 0) ? -1 : 1) / (float) m_quality.age;
+    m_quality.window = 0;
+  }
 }
 
 #endif // ENABLE_ENC_CLASS
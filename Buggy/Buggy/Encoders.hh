@@ -25,6 +25,12 @@
 #define E3_ChB 19 // pink   is /B
 #define E4_ChA 20 // yellow is /A
 #define E4_ChB 21 // pink   is /B
+
+/* The wheel each encoder (E1..E4) is on, and the sign that makes forwards positive; the encoders on the right
+ * turn the other way to those on the left. Check these on the car
+ */
+#define ENCODER_WHEELS { wh_FL, wh_BL, wh_FR, wh_BR }
+#define ENCODER_SIGNS  { -1, -1, 1, 1 }
 #endif
 
 #ifndef ENABLE_ENC_CLASS
@@ -94,44 +100,233 @@ static float s_encoder_rpm() { // Calculate RPM
 
 #else // ENABLE_ENC_CLASS
 
+#include "Ring.hh"
+#include "SeqLock.hh"
+
+#define ENCODER_EDGES      64     // edge timestamps queued by the interrupt between syncs; must be a power of two
+#define ENCODER_HISTORY    16     // recent edges kept for choosing the estimation window; must be a power of two
+#define ENCODER_EDGES_MIN  8      // the window is extended back until it spans at least this many counts...
+#define ENCODER_WINDOW_MAX 100000 // ... or this many microseconds
+#define ENCODER_TIMEOUT    500000 // no edge for this many microseconds means stopped
+
+#if defined(TEENSYDUINO) && !defined(__IMXRT1062__)
+typedef volatile uint8_t  encoder_port_t; // Teensy 3: one bit-band register per pin
+#else
+typedef volatile uint32_t encoder_port_t;
+#endif
+
+enum Wheel {
+  wh_FL = 0, // front left  (non-powered)
+  wh_BL,     // back  left  (powered)
+  wh_FR,     // front right (powered)
+  wh_BR,     // back  right (non-powered)
+  wh_Count
+};
+
+/* Velocity is estimated with the M/T method: counts between two edges over the exact time between them. The
+ * interrupt keeps the latest position & edge time, and queues a timestamp for each edge; sync() picks the
+ * start of the window from the recent edges, going back far enough for ENCODER_EDGES_MIN counts, so that
+ * the window is short at speed and long when slow. When no edge arrives for longer than the estimated edge
+ * period, the estimate is limited to one count over the time since the last edge, decaying smoothly to zero.
+ */
 class Encoder {
+public:
+  struct Edge {
+    unsigned long time;     // micros() at the edge
+    long          position; // net count after the edge
+  };
+
+  struct Snapshot { // interrupt-side state; all are running totals
+    long          position;
+    unsigned long time;
+    unsigned long illegal;
+    unsigned long dropped;
+  };
+
+  struct Quality {
+    unsigned long edges;   // counts in the window used for the latest estimate
+    unsigned long window;  // microseconds spanned by that window; 0 if the estimate is limited by the last edge's age
+    unsigned long age;     // microseconds since the last edge
+    unsigned long illegal; // transitions where both channels changed, i.e., a missed edge
+    unsigned long dropped; // edge timestamps not queued because the ring was full
+  };
+
+  /* Quadrature decoding: the state is (A << 1) | B, and the table is indexed by (previous << 2) | current;
+   * +1/-1 for a step in either direction, 0 for no change, and s_illegal if both channels changed, i.e., an
+   * edge was missed. Positive is B leading A.
+   */
+  static const signed char s_quadrature[16];
+  static const signed char s_illegal = 2;
+
 private:
-  void (*ch_A_interrupt)();
-  void (*ch_B_interrupt)();
+  const encoder_port_t * port_A; // input registers, for direct reads in the interrupt
+  const encoder_port_t * port_B;
+  uint32_t mask_A;
+  uint32_t mask_B;
 
-  float (*synchronise)(unsigned long & last_elapsed, unsigned long & last_count); // returns latest elapsed time and pulse count
+  volatile unsigned char state; // (A << 1) | B
 
-  float cpr;   // counts per revolution = 4 * ppr
-  float sense; // 1 for clockwise-is-positive; -1 otherwise
-  float rev_s;
+  SeqLock<Snapshot>         m_snapshot; // written by the interrupt only
+  Ring<Edge, ENCODER_EDGES> m_edges;    // interrupt to sync()
 
-  elapsedMicros dsync;
-public:
-  elapsedMicros timer; // for interrupt use only
+  Edge     m_history[ENCODER_HISTORY];
+  unsigned m_history_count;
+  unsigned long m_last_time;
 
-  int ch_A_pin; // use init() to set
-  int ch_B_pin;
+  Quality m_quality;
 
-  Encoder(void (*ch_A_int)(), void (*ch_B_int)(), float (*sync)(unsigned long & last_elapsed, unsigned long & last_count)) :
-    ch_A_interrupt(ch_A_int),
-    ch_B_interrupt(ch_B_int),
-    synchronise(sync)
+public:
+  float counts_us; // latest estimate, in counts per microsecond
+
+  Encoder() :
+    state(0),
+    m_history_count(0),
+    m_last_time(0),
+    counts_us(0)
   {
     // ...
   }
   ~Encoder() {
     // ...
   }
-  void init(int pin_A, int pin_B, unsigned ppr, bool clockwise=true);
+  void init(int pin_A, int pin_B, void (*edge_interrupt)());
   void sync();
 
-  inline float latest() const { return rev_s; }
+  inline const Quality & quality() const { return m_quality; }
+
+  /* Both channels in one port read, if they share a port (e.g., on Teensy 4)
+   */
+  inline unsigned char pins() const {
+    uint32_t a = *port_A;
+    uint32_t b = (port_B == port_A) ? a : *port_B;
+    return ((a & mask_A) ? 2 : 0) | ((b & mask_B) ? 1 : 0);
+  }
+
+  /* The interrupt handler, for either channel
+   */
+  inline void edge() {
+    unsigned char now = pins();
+    signed char step = s_quadrature[(state << 2) | now];
+    state = now;
+
+    if (step) {
+      Snapshot & S = m_snapshot.write_begin();
+      if (step == s_illegal) {
+        ++S.illegal;
+      } else {
+        Edge E;
+        E.time = micros();
+        E.position = S.position + step;
+        S.position = E.position;
+        S.time = E.time;
+        if (!m_edges.push(E)) {
+          ++S.dropped;
+        }
+      }
+      m_snapshot.write_end();
+    }
+  }
+};
+
+/* EncoderBank<pin_A, pin_B, ...> has one Encoder per pair of pins, in a single array, with an interrupt
+ * handler generated for each; there can be only one bank of any given set of pins.
+ */
+template <int... Pins>
+class EncoderBank {
+public:
+  static const int N = sizeof...(Pins) / 2;
+
+  static_assert(N > 0 && sizeof...(Pins) == 2 * N, "EncoderBank: pins must be in pairs");
+
+private:
+  template <int I> struct Index { };
+
+  static EncoderBank * s_bank;
+
+  template <int I>
+  static void s_edge() {
+    s_bank->m_encoder[I].edge();
+  }
+
+  static int s_pin(int i) {
+    static const int pins[] = { Pins... };
+    return pins[i];
+  }
+
+  void attach(Index<0>) {
+    // ...
+  }
+  template <int I>
+  void attach(Index<I>) {
+    attach(Index<I-1>());
+    m_encoder[I-1].init(s_pin(2 * (I-1)), s_pin(2 * (I-1) + 1), s_edge<I-1>);
+  }
+
+  Encoder m_encoder[N];
+  float   m_sign[N];
+  float   m_rev_s[N];       // latest speed of each encoder, revolutions per second, positive forwards
+  int     m_wheel[wh_Count]; // encoder index for each wheel, or -1
+
+  float m_scale; // counts per microsecond => revolutions per second
+
+public:
+  EncoderBank() :
+    m_scale(0)
+  {
+    for (int i = 0; i < N; i++) {
+      m_sign[i] = 1;
+      m_rev_s[i] = 0;
+    }
+    for (int w = 0; w < wh_Count; w++) {
+      m_wheel[w] = -1;
+    }
+  }
+
+  ~EncoderBank() {
+    // ...
+  }
+
+  void init(unsigned ppr, const int (&wheels)[N], const int (&signs)[N]) {
+    m_scale = 1E6 / (4 * (float) ppr);
+
+    for (int i = 0; i < N; i++) {
+      m_sign[i] = (signs[i] < 0) ? -1 : 1;
+      if (wheels[i] >= 0 && wheels[i] < wh_Count) {
+        m_wheel[wheels[i]] = i;
+      }
+    }
+    s_bank = this;
+    attach(Index<N>());
+  }
+
+  /* Update all the speed estimates
+   */
+  void sync() {
+    for (int i = 0; i < N; i++) {
+      m_encoder[i].sync();
+    }
+    for (int i = 0; i < N; i++) { // scaling, in one pass
+      m_rev_s[i] = m_sign[i] * m_scale * m_encoder[i].counts_us;
+    }
+  }
+
+  inline float latest(int i) const { // revolutions per second, by encoder index
+    return m_rev_s[i];
+  }
+  inline float wheel(Wheel w) const { // revolutions per second, by wheel
+    return (m_wheel[w] < 0) ? 0 : m_rev_s[m_wheel[w]];
+  }
+  inline const Encoder & encoder(int i) const {
+    return m_encoder[i];
+  }
 };
 
-extern Encoder E1;
-extern Encoder E2;
-extern Encoder E3;
-extern Encoder E4;
+template <int... Pins>
+EncoderBank<Pins...> * EncoderBank<Pins...>::s_bank = 0;
+
+typedef EncoderBank<E1_ChA, E1_ChB, E2_ChA, E2_ChB, E3_ChA, E3_ChB, E4_ChA, E4_ChB> Encoders_t;
+
+extern Encoders_t Encoders;
 
 #endif // ENABLE_ENC_CLASS
 
@@ -0,0 +1,90 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_Fixed_hh
+#define cariot_Fixed_hh
+
+#include <stdint.h>
+
+/** Fixed is a signed Q16.16 fixed-point number, i.e., a range of about +/-32768 with a resolution of 1/65536,
+ * for arithmetic on cores without an FPU (e.g., the Cortex-M0+ of the Feather M0), where every float operation
+ * is a library call. Addition, subtraction and multiplication saturate rather than wrap around, so that a
+ * controller driven out of range pins at the limit instead of changing sign. Conversion from float rounds to
+ * nearest; conversion to int truncates toward zero, as a cast from float does.
+ *
+ * There is deliberately no division: divide once, in float, when a coefficient changes, and multiply by the
+ * reciprocal in the loop.
+ */
+class Fixed {
+private:
+  int32_t m_raw;
+
+  static inline int32_t s_saturate(int64_t value) {
+    return (value > INT32_MAX) ? INT32_MAX : ((value < INT32_MIN) ? INT32_MIN : (int32_t) value);
+  }
+  static inline int32_t s_from(float value) {
+    float raw = value * 65536.0f;
+    if (raw >= 2147483647.0f) {
+      return INT32_MAX;
+    }
+    if (raw <= -2147483648.0f) {
+      return INT32_MIN;
+    }
+    return (int32_t) ((raw < 0) ? (raw - 0.5f) : (raw + 0.5f));
+  }
+
+public:
+  Fixed() :
+    m_raw(0)
+  {
+    // ...
+  }
+
+  Fixed(float value) :
+    m_raw(s_from(value))
+  {
+    // ...
+  }
+
+  ~Fixed() {
+    // ...
+  }
+
+  static inline Fixed raw(int32_t value) {
+    Fixed F;
+    F.m_raw = value;
+    return F;
+  }
+  inline int32_t raw() const { return m_raw; }
+
+  explicit operator float () const { return (float) m_raw / 65536.0f; }
+  explicit operator int () const   { return m_raw / 65536; }
+
+  inline Fixed operator - () const {
+    return raw(s_saturate(-(int64_t) m_raw));
+  }
+  inline Fixed operator + (const Fixed & rhs) const {
+    return raw(s_saturate((int64_t) m_raw + rhs.m_raw));
+  }
+  inline Fixed operator - (const Fixed & rhs) const {
+    return raw(s_saturate((int64_t) m_raw - rhs.m_raw));
+  }
+  inline Fixed operator * (const Fixed & rhs) const { // 32x32->64 multiply, rounded back to Q16.16
+    return raw(s_saturate(((int64_t) m_raw * rhs.m_raw + 0x8000) >> 16));
+  }
+
+  inline Fixed & operator += (const Fixed & rhs) { return *this = *this + rhs; }
+  inline Fixed & operator -= (const Fixed & rhs) { return *this = *this - rhs; }
+  inline Fixed & operator *= (const Fixed & rhs) { return *this = *this * rhs; }
+
+  inline bool operator <  (const Fixed & rhs) const { return m_raw <  rhs.m_raw; }
+  inline bool operator >  (const Fixed & rhs) const { return m_raw >  rhs.m_raw; }
+  inline bool operator <= (const Fixed & rhs) const { return m_raw <= rhs.m_raw; }
+  inline bool operator >= (const Fixed & rhs) const { return m_raw >= rhs.m_raw; }
+  inline bool operator == (const Fixed & rhs) const { return m_raw == rhs.m_raw; }
+  inline bool operator != (const Fixed & rhs) const { return m_raw != rhs.m_raw; }
+};
+
+#endif /* !cariot_Fixed_hh */
@@ -0,0 +1,233 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#include "config.hh"
+#include "Format.hh"
+
+static const unsigned long s_pow10[] = {
+  1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL
+};
+
+static int s_digits(unsigned long value) { // number of decimal digits, at least one
+  int count = 1;
+  while ((count < 10) && (value >= s_pow10[count])) {
+    ++count;
+  }
+  return count;
+}
+
+Format::Format(Commander & C) :
+  m_C(&C),
+  m_span(0),
+  m_space(0),
+  m_count(0),
+  m_length(0)
+{
+  // ...
+}
+
+Format::Format(char * buffer, int size) :
+  m_C(0),
+  m_span(buffer),
+  m_space(size - 1), // room for the terminator
+  m_count(0),
+  m_length(0)
+{
+  if (size > 0) {
+    *buffer = 0;
+  } else {
+    m_span = 0;
+    m_space = 0;
+  }
+}
+
+void Format::begin() {
+  if (m_C) {
+    m_space = m_C->ui_span(m_span);
+    m_count = 0;
+  }
+}
+
+void Format::put(char c) {
+  if (!m_space && m_C && m_count) { // the span wrapped around; there may be more space at the start
+    m_C->ui_commit(m_count);
+    begin();
+  }
+  if (m_space) {
+    m_span[m_count++] = c;
+    --m_space;
+  }
+}
+
+void Format::end() {
+  if (m_C) {
+    m_C->ui_commit(m_count);
+    m_count = 0;
+    m_space = 0;
+  } else if (m_span) {
+    m_span[m_count] = 0;
+    m_length = m_count;
+  }
+}
+
+void Format::digits(unsigned long value, int count) {
+  char buf[10];
+  int i = count;
+  while (i--) {
+    buf[i] = (char) ('0' + value % 10);
+    value /= 10;
+  }
+  for (i = 0; i < count; i++) {
+    put(buf[i]);
+  }
+}
+
+/* value x 10^-decimals
+ */
+void Format::number(bool bNegative, unsigned long value, int decimals, int width, char pad) {
+  unsigned long whole = value / s_pow10[decimals];
+  int length = s_digits(whole) + (decimals ? (decimals + 1) : 0);
+
+  if (!value) {
+    bNegative = false; // no "-0.00"
+  }
+  if (bNegative) {
+    ++length;
+  }
+  if (bNegative && (pad == '0')) { // the sign goes before zeros, but after spaces
+    put('-');
+  }
+  while (width-- > length) {
+    put(pad);
+  }
+  if (bNegative && (pad != '0')) {
+    put('-');
+  }
+  digits(whole, s_digits(whole));
+  if (decimals) {
+    put('.');
+    digits(value % s_pow10[decimals], decimals);
+  }
+}
+
+Format & Format::ch(char c) {
+  begin();
+  put(c);
+  end();
+  return *this;
+}
+
+Format & Format::str(const char * s) {
+  begin();
+  while (s && *s) {
+    put(*s++);
+  }
+  end();
+  return *this;
+}
+
+Format & Format::dec(long value, int width, char pad) {
+  begin();
+  number(value < 0, (value < 0) ? (0UL - (unsigned long) value) : (unsigned long) value, 0, width, pad);
+  end();
+  return *this;
+}
+
+Format & Format::udec(unsigned long value, int width, char pad) {
+  begin();
+  number(false, value, 0, width, pad);
+  end();
+  return *this;
+}
+
+Format & Format::hex(unsigned long value) {
+  static const char s_hex[] = "0123456789abcdef";
+
+  int shift = 28;
+  while (shift && !(value >> shift)) {
+    shift -= 4;
+  }
+  begin();
+  for ( ; shift >= 0; shift -= 4) {
+    put(s_hex[(value >> shift) & 0xF]);
+  }
+  end();
+  return *this;
+}
+
+Format & Format::fixed(float value, int decimals, int width) {
+  if (decimals < 0) {
+    decimals = 0;
+  } else if (decimals > FORMAT_DECIMALS_MAX) {
+    decimals = FORMAT_DECIMALS_MAX;
+  }
+  bool bNegative = (value < 0);
+  float magnitude = bNegative ? -value : value;
+
+  begin();
+  if (magnitude * (float) s_pow10[decimals] < 4294967040.0f) { // i.e., fits in an unsigned long
+    /* Scale only the fraction, which is exact in float, so that a large value doesn't gain digits that
+     * the float doesn't have
+     */
+    unsigned long whole = (unsigned long) magnitude;
+    unsigned long part  = (unsigned long) ((magnitude - (float) whole) * (float) s_pow10[decimals] + 0.5f);
+
+    number(bNegative, whole * s_pow10[decimals] + part, decimals, width, ' '); // part may round up to a carry
+  } else { // too big, or not a number
+    while (width-- > 3) {
+      put(' ');
+    }
+    put(bNegative ? '-' : '?');
+    put('?');
+    put('?');
+  }
+  end();
+  return *this;
+}
+
+Format & Format::fixed(long value, int exponent, int decimals, int width) {
+  bool bNegative = (value < 0);
+  unsigned long magnitude = bNegative ? (0UL - (unsigned long) value) : (unsigned long) value;
+
+  if (decimals > exponent) {
+    decimals = exponent;
+  }
+  if (decimals < exponent) { // round off the extra places
+    unsigned long p = s_pow10[exponent - decimals];
+    magnitude = (magnitude + p / 2) / p;
+  }
+  begin();
+  number(bNegative, magnitude, decimals, width, ' ');
+  end();
+  return *this;
+}
+
+Format & Format::dms(long degrees, char positive, char negative) {
+  char hemisphere = (degrees < 0) ? negative : positive;
+  unsigned long magnitude = (degrees < 0) ? (0UL - (unsigned long) degrees) : (unsigned long) degrees;
+
+  unsigned long whole = magnitude / 10000000UL;
+  unsigned long part  = (magnitude % 10000000UL) * 60;  // minutes x 10^7
+  unsigned long minutes = part / 10000000UL;
+  unsigned long seconds = ((part % 10000000UL) * 60 + 500) / 1000;     // seconds x 10^4, rounded
+
+  if (seconds >= 600000UL) { // rounded up to a whole minute
+    seconds -= 600000UL;
+    if (++minutes == 60) {
+      minutes = 0;
+      ++whole;
+    }
+  }
+  begin();
+  number(false, whole, 0, 3, ' ');
+  put('^');
+  digits(minutes, 2);
+  put('\'');
+  number(false, seconds, 4, 0, ' ');
+  put('"');
+  put(hemisphere);
+  end();
+  return *this;
+}
@@ -0,0 +1,66 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_Format_hh
+#define cariot_Format_hh
+
+#include "Commander.hh"
+
+#define FORMAT_DECIMALS_MAX 6 // most decimal places that fixed() will write
+
+/* Format writes numbers as text without printf, so that reports don't need the float printf code, and
+ * writes them either straight into a Commander's output FIFO (via ui_span(), as UI text; the caller ends the
+ * line with ui() as usual) or into a char buffer, which is kept nul-terminated, e.g., for command_print().
+ * Each call writes what fits; output that doesn't fit is dropped.
+ *
+ * Widths are minimum field widths, padded on the left, as with printf's "%6.2f" or "%02d".
+ */
+class Format {
+private:
+  Commander * m_C;
+  char *      m_span;   // current output span
+  int         m_space;  // space left in the span
+  int         m_count;  // characters written to the current span
+  int         m_length; // buffer mode: length so far
+
+  void begin();
+  void put(char c);
+  void end();
+
+  void digits(unsigned long value, int count); // exactly count digits, with leading zeros
+  void number(bool bNegative, unsigned long value, int decimals, int width, char pad);
+
+public:
+  Format(Commander & C);
+  Format(char * buffer, int size);
+
+  ~Format() {
+    // ...
+  }
+
+  inline int length() const { // buffer mode: string length
+    return m_length;
+  }
+
+  Format & ch(char c);
+  Format & str(const char * s);
+  Format & dec(long value, int width = 0, char pad = ' ');
+  Format & udec(unsigned long value, int width = 0, char pad = ' ');
+  Format & hex(unsigned long value);
+
+  /* Decimal with a fixed number of places, rounded, e.g., fixed(v, 2, 6) for "%6.2f"
+   */
+  Format & fixed(float value, int decimals, int width = 0);
+
+  /* Decimal from an integer value x 10^-exponent, e.g., fixed(latitude, 7, 6) for degrees x 10^7 as "%.6f"
+   */
+  Format & fixed(long value, int exponent, int decimals, int width = 0);
+
+  /* Degrees (x 10^7) as degrees, minutes & seconds: "ddd^mm'ss.ssss"H", with H the hemisphere
+   */
+  Format & dms(long degrees, char positive, char negative);
+};
+
+#endif /* !cariot_Format_hh */
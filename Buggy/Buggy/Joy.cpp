@@ -18,17 +18,26 @@ static Joy *s_J = 0;
 static const char     address = 0x49;
 static const unsigned pinmask = 0x46C0;
 
-static void s_write_pins(char lo) {
-  static char data[6] = { 0x01, 0x00, 0x00, 0x00, 0x46, 0xC0 }; // see pinmask
-
-  data[1] = lo;
-
-  Wire.beginTransmission(address);
-  Wire.write(data, 6);
-  Wire.endTransmission();
-
-  delayMicroseconds(200);
-}
+/* Protothread-style sequencing for Joy::tick(): JOY_PT_WAIT returns from tick() until the condition holds,
+ * and resumes at the same point on the next call; locals don't survive, so state is kept in members
+ */
+#define JOY_PT_BEGIN      switch (m_pt) { case 0:
+#define JOY_PT_WAIT(c)    do { m_pt = __LINE__; case __LINE__: if (!(c)) return false; } while (0)
+#define JOY_PT_YIELD(v)   do { m_pt = __LINE__; return (v); case __LINE__: ; } while (0)
+#define JOY_PT_END        } m_pt = 0;
+
+static const uint8_t s_init[3][6] = { // see pinmask
+  { 0x01, 0x03, 0x00, 0x00, 0x46, 0xC0 }, // GPIO: direction input
+  { 0x01, 0x0B, 0x00, 0x00, 0x46, 0xC0 }, // GPIO: pull-up enable
+  { 0x01, 0x05, 0x00, 0x00, 0x46, 0xC0 }  // GPIO: bulk set, i.e., pull up
+};
+
+static const uint8_t s_sequence[3][2] = {
+  { 0x09, 0x08 }, // ADC channel 3: x
+  { 0x09, 0x07 }, // ADC channel 2: y
+  { 0x01, 0x04 }  // GPIO bulk read: buttons
+};
+static const int s_sequence_length[3] = { 2, 2, 4 };
 
 Joy * Joy::joy() {
   static Joy joy;
@@ -44,13 +53,7 @@ Joy * Joy::joy() {
 #else
     Wire.begin();
 #endif
-
-    delayMicroseconds(200);
-    s_write_pins(0x03);
-    s_write_pins(0x0B);
-    s_write_pins(0x05);
-
-    s_J = &joy;
+    s_J = &joy; // the pin setup is the first part of the tick() sequence
   }
   return s_J;
 }
@@ -64,221 +67,130 @@ static inline float s_map(int reading) {
   return value;
 }
 
-bool Joy::tick() {
-  const unsigned long interval = 100;
-
-  bool sequence_complete = false;
-
-  switch(m_mode) {
-    case jm_x_send:
-    {
-      m_changes = 0;
+void Joy::send(const uint8_t * data, int length) {
+  m_bDone = false;
 
-      char data[2];
-      data[0] = 0x09;
-      data[1] = 0x08;
-
-      // Serial.println("i2c: sending...");
-      Wire.beginTransmission(address);
-      Wire.write(data, 2);
+  Wire.beginTransmission(address);
+  Wire.write(data, length);
 #if defined(TEENSYDUINO)
-      Wire.sendTransmission();
-      m_mode = jm_x_sending;
+  Wire.sendTransmission(); // s_transmit() or s_error() will set m_bDone
 #else
-      Wire.endTransmission();
-      m_mode = jm_x_request;
-      m_ticker = 0;
+  Wire.endTransmission();
+  m_bDone = true;
 #endif
-      break;
-    }
-    case jm_x_request:
-    {
-      if (m_ticker < interval) break;
+}
+
+void Joy::request(int length) {
+  m_bDone = false;
 
 #if defined(TEENSYDUINO)
-      Wire.sendRequest(address, 2);
-      m_mode = jm_x_requesting;
+  Wire.sendRequest(address, length); // s_request() or s_error() will set m_bDone
 #else
-      Wire.requestFrom(address, 2);
-      m_mode = jm_x_read;
-      m_ticker = 0;
+  Wire.requestFrom(address, length);
+  m_bDone = true;
 #endif
-      break;
-    }
-    case jm_x_read:
-    {
-      int value = 0;
-      while (Wire.available()) {
-        char data;
+}
+
+unsigned long Joy::read() {
+  unsigned long value = 0;
+
+  while (Wire.available()) {
+    char data;
 #if defined(TEENSYDUINO)
-        Wire.read(&data, 1);
+    Wire.read(&data, 1);
 #else
-        data = Wire.read();
+    data = Wire.read();
 #endif
-        value = (value << 8) | data;
-      }
-      float new_x = s_map(value);
+    value = (value << 8) | (unsigned char) data;
+  }
+  return value;
+}
+
+void Joy::store(int step, unsigned long value) {
+  switch (step) {
+  case 0:
+    {
+      float new_x = s_map((int) value);
       if (m_x != new_x) {
         m_x = new_x;
         m_changes |= 0x0001;
       }
-
-      m_mode = jm_y_send;
-      break;
-    }
-
-    case jm_y_send:
-    {
-      if (m_ticker < interval) break;
-
-      char data[2];
-      data[0] = 0x09;
-      data[1] = 0x07;
-
-      // Serial.println("i2c: sending...");
-      Wire.beginTransmission(address);
-      Wire.write(data, 2);
-#if defined(TEENSYDUINO)
-      Wire.sendTransmission();
-      m_mode = jm_y_sending;
-#else
-      Wire.endTransmission();
-      m_mode = jm_y_request;
-      m_ticker = 0;
-#endif
-      break;
-    }
-    case jm_y_request:
-    {
-      if (m_ticker < interval) break;
-
-#if defined(TEENSYDUINO)
-      Wire.sendRequest(address, 2);
-      m_mode = jm_y_requesting;
-#else
-      Wire.requestFrom(address, 2);
-      m_mode = jm_y_read;
-      m_ticker = 0;
-#endif
       break;
     }
-    case jm_y_read:
+  case 1:
     {
-      int value = 0;
-      while (Wire.available()) {
-        char data;
-#if defined(TEENSYDUINO)
-        Wire.read(&data, 1);
-#else
-        data = Wire.read();
-#endif
-        value = (value << 8) | data;
-      }
-      float new_y = -s_map(value);
+      float new_y = -s_map((int) value);
       if (m_y != new_y) {
         m_y = new_y;
         m_changes |= 0x0002;
       }
-
-      m_mode = jm_s_send;
-      break;
-    }
-
-    case jm_s_send:
-    {
-      if (m_ticker < interval) break;
-
-      char data[2];
-      data[0] = 0x01;
-      data[1] = 0x04;
-
-      // Serial.println("i2c: sending...");
-      Wire.beginTransmission(address);
-      Wire.write(data, 2);
-#if defined(TEENSYDUINO)
-      Wire.sendTransmission();
-      m_mode = jm_s_sending;
-#else
-      Wire.endTransmission();
-      m_mode = jm_s_request;
-      m_ticker = 0;
-#endif
-      break;
-    }
-    case jm_s_request:
-    {
-      if (m_ticker < interval) break;
-
-#if defined(TEENSYDUINO)
-      Wire.sendRequest(address, 4);
-      m_mode = jm_s_requesting;
-#else
-      Wire.requestFrom(address, 4);
-      m_mode = jm_s_read;
-      m_ticker = 0;
-#endif
       break;
     }
-    case jm_s_read:
+  default:
     {
-      unsigned long value = 0;
-      while (Wire.available()) {
-        char data;
-#if defined(TEENSYDUINO)
-        Wire.read(&data, 1);
-#else
-        data = Wire.read();
-#endif
-        value = (value << 8) | data;
-      }
       unsigned new_state = ~value & pinmask;
       if (m_state != new_state) {
         m_changes |= m_state ^ new_state;
         m_state = new_state;
       }
+      break;
+    }
+  }
+}
 
-      // we've completed the update; return true
-      sequence_complete = true;
+bool Joy::tick() {
+  JOY_PT_BEGIN
 
-      m_mode = jm_Idle;
-      break;
+  for (m_step = 0; m_step < 3; m_step++) { // pin setup
+    send(s_init[m_step], 6);
+    JOY_PT_WAIT(m_bDone);
+    m_ticker = 0;
+    JOY_PT_WAIT(m_ticker >= JOY_I2C_GAP);
+  }
+
+  while (true) {
+    JOY_PT_WAIT(m_bStart || (m_period && (m_sample >= m_period)));
+    m_bStart = false;
+    m_sample = 0;
+    m_changes = 0;
+
+    for (m_step = 0; m_step < 3; m_step++) {
+      send(s_sequence[m_step], 2);
+      JOY_PT_WAIT(m_bDone);
+      m_ticker = 0;
+      JOY_PT_WAIT(m_ticker >= JOY_I2C_GAP);
+
+      request(s_sequence_length[m_step]);
+      JOY_PT_WAIT(m_bDone);
+      store(m_step, read());
     }
 
-    default:
-    {
-      break;
+    ++m_count;
+    if (m_window >= 1000000) {
+      m_rate = (unsigned) ((m_count * 1000000ULL) / (unsigned long) m_window);
+      m_count = 0;
+      m_window = 0;
     }
+    JOY_PT_YIELD(true); // sample complete
   }
-  return sequence_complete;
+
+  JOY_PT_END
+  return false;
 }
 
 #if defined(TEENSYDUINO)
 
 void Joy::s_transmit() {
-  // Serial.print("i2c: event: transmit: ");
-  switch(s_J->m_mode) {
-    case jm_x_sending: s_J->m_mode = jm_x_request; break;
-    case jm_y_sending: s_J->m_mode = jm_y_request; break;
-    case jm_s_sending: s_J->m_mode = jm_s_request; break;
-
-    default: break;
-  }
-  s_J->m_ticker = 0;
+  s_J->m_bDone = true;
 }
 
 void Joy::s_request() {
-  // Serial.print("i2c: event: request: ");
-  switch(s_J->m_mode) {
-    case jm_x_requesting: s_J->m_mode = jm_x_read; break;
-    case jm_y_requesting: s_J->m_mode = jm_y_read; break;
-    case jm_s_requesting: s_J->m_mode = jm_s_read; break;
-
-    default: break;
-  }
-  s_J->m_ticker = 0;
+  s_J->m_bDone = true;
 }
 
 void Joy::s_error() {
+  s_J->m_bDone = true; // abandon the transfer; the sequence carries on
+
   Serial.print("i2c: event: error: ");
   switch (Wire.status()) {
     case I2C_TIMEOUT:  Serial.println("I2C timeout"); Wire.resetBus(); break;
@@ -1,33 +1,34 @@
 /* Copyright 2020 Francis James Franklin
- * 
+ *
  * Open Source under the MIT License - see LICENSE in the project's root folder
  */
 
 #ifndef cariot_joy_hh
 #define cariot_joy_hh
 
+#define JOY_SAMPLE_PERIOD 10000 // microseconds between the start of each sample; 0 to sample only on start()
+#define JOY_I2C_GAP         100 // microseconds the seesaw needs between a register write and the read
+
+/* Joy reads the JoyWing's seesaw chip without blocking: tick() resumes a protothread-style sequence that
+ * waits (by returning) for each I2C transfer and for the gaps the seesaw needs between them. With the Teensy's
+ * i2c_t3, transfers are asynchronous; with Wire, each transfer blocks for its duration only.
+ *
+ * The seesaw ADC returns one channel per request, so a sample is three request cycles: x, y, and all the
+ * buttons in a single bulk GPIO read.
+ */
 class Joy {
 private:
-  elapsedMicros m_ticker;
-
-  enum JoyMode {
-    jm_Idle = 0,
-    jm_x_send,
-    jm_x_sending,
-    jm_x_request,
-    jm_x_requesting,
-    jm_x_read,
-    jm_y_send,
-    jm_y_sending,
-    jm_y_request,
-    jm_y_requesting,
-    jm_y_read,
-    jm_s_send,
-    jm_s_sending,
-    jm_s_request,
-    jm_s_requesting,
-    jm_s_read
-  } m_mode;
+  elapsedMicros m_ticker; // gaps between transfers
+  elapsedMicros m_sample; // since the start of the current sample
+  elapsedMicros m_window; // sample rate measurement
+
+  unsigned long m_period;
+
+  int m_pt;   // protothread resume point
+  int m_step; // index of the current transfer in the sequence
+
+  volatile bool m_bDone; // current I2C transfer complete
+  bool m_bStart;
 
   float m_x;
   float m_y;
@@ -35,19 +36,35 @@ private:
   unsigned m_state;
   unsigned m_changes;
 
+  unsigned m_count; // samples in the current window
+  unsigned m_rate;  // samples per second, over the last full window
+
 #if defined(TEENSYDUINO)
   static void s_transmit();
   static void s_request();
   static void s_error();
 #endif
 
+  void send(const uint8_t * data, int length);
+  void request(int length);
+  unsigned long read();
+  void store(int step, unsigned long value);
+
   Joy() :
     m_ticker(0),
-    m_mode(jm_Idle),
+    m_sample(0),
+    m_window(0),
+    m_period(JOY_SAMPLE_PERIOD),
+    m_pt(0),
+    m_step(0),
+    m_bDone(false),
+    m_bStart(false),
     m_x(0),
     m_y(0),
     m_state(0),
-    m_changes(0)
+    m_changes(0),
+    m_count(0),
+    m_rate(0)
   {
     // ...
   }
@@ -57,14 +74,15 @@ public:
   ~Joy() {
     // ...
   }
-  bool tick();
+  bool tick(); // returns true when a sample is complete
 
-  inline void start() {
-    if (!m_mode) {
-      m_mode = jm_x_send;
-    }
+  inline void start() { // sample now, rather than at the next period
+    m_bStart = true;
+  }
+  inline void period(unsigned long us) {
+    m_period = us;
   }
-  inline bool idle() const { return m_mode == jm_Idle; }
+  inline unsigned rate() const { return m_rate; }
 
   inline float x() const { return m_x; }
   inline float y() const { return m_y; }
@@ -129,7 +129,7 @@ public:
 };
 
 LoRaCommander::LoRaCommander(Commander::Responder * R, unsigned char id_self, unsigned char id_partner) :
-  Commander(R),
+  Commander(R, ct_LoRa),
   m_id_self(id_self),
   m_id_partner(id_partner),
 #ifdef FEATHER_M0_LORA
@@ -225,6 +225,10 @@ void LoRaCommander::command_send(char code, unsigned long value) {
 #endif
 }
 
+void LoRaCommander::command_frame(const char * frame, int length) {
+  //
+}
+
 void LoRaCommander::command_print(const char * str) {
   m_chain->print(str);
 }
@@ -233,6 +237,18 @@ void LoRaCommander::ui(char c) {
   //
 }
 
+void LoRaCommander::ui_write(const char * str, size_t length) {
+  //
+}
+
+int LoRaCommander::ui_span(char *& span) {
+  return 0;
+}
+
+void LoRaCommander::ui_commit(int count) {
+  //
+}
+
 #if 0
 bool LoRaCommander::print(const char * str) {
   return m_chain->print(str);
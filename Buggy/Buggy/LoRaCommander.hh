@@ -38,8 +38,12 @@ private:
   int available();
 public:
   virtual void command_send(char code, unsigned long value = 0);
+  virtual void command_frame(const char * frame, int length);
   virtual void command_print(const char * str);
   virtual void ui(char c = 0);
+  virtual void ui_write(const char * str, size_t length);
+  virtual int ui_span(char *& span);
+  virtual void ui_commit(int count);
 public:
   virtual void update(bool flush_output=false);
 };
@@ -0,0 +1,242 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#include "config.hh"
+#ifdef ENABLE_GPS
+
+#include "NMEA.hh"
+
+#define NMEA_ID(a,b,c) (((unsigned long) (a) << 16) | ((unsigned long) (b) << 8) | (unsigned long) (c))
+
+NMEA::NMEA() :
+  m_id(0),
+  m_value(0),
+  m_decimals(0),
+  m_state(ns_Idle),
+  m_sentence(st_Other),
+  m_field(0),
+  m_sum(0),
+  m_check(0),
+  m_char(0),
+  m_bPoint(false),
+  m_bEmpty(true)
+{
+  memset(&m_fix, 0, sizeof(m_fix));
+  m_pending = m_fix;
+  clear();
+}
+
+void NMEA::clear() {
+  m_stats.sentences = 0;
+  m_stats.errors = 0;
+  m_stats.ignored = 0;
+}
+
+unsigned long NMEA::s_scale(unsigned long value, int decimals, int target) {
+  while (decimals < target) {
+    value *= 10;
+    ++decimals;
+  }
+  while (decimals > target) {
+    value /= 10;
+    --decimals;
+  }
+  return value;
+}
+
+/* [d]ddmm.mmmmm to degrees x 10^7
+ */
+long NMEA::s_degrees(unsigned long value, int decimals) {
+  unsigned long dddmm = s_scale(value, decimals, 5); // i.e., minutes x 10^5, plus degrees x 10^7
+
+  unsigned long degrees = dddmm / 10000000UL;
+  unsigned long minutes = dddmm % 10000000UL;
+
+  return (long) (degrees * 10000000UL + (minutes * 100 + 30) / 60);
+}
+
+int NMEA::s_hex(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+void NMEA::begin_field() {
+  m_value = 0;
+  m_decimals = 0;
+  m_char = 0;
+  m_bPoint = false;
+  m_bEmpty = true;
+}
+
+void NMEA::end_field() {
+  if (m_field == 0) {
+    switch (m_id) {
+    case NMEA_ID('R','M','C'):
+      m_sentence = st_RMC;
+      break;
+    case NMEA_ID('G','G','A'):
+      m_sentence = st_GGA;
+      break;
+    default:
+      m_sentence = st_Other;
+      break;
+    }
+    return;
+  }
+  if ((m_sentence == st_Other) || m_bEmpty) {
+    return;
+  }
+
+  /* RMC: 1 time, 2 status, 3 lat, 4 N/S, 5 lon, 6 E/W, 7 speed, 8 course, 9 date
+   * GGA: 1 time, 2 lat, 3 N/S, 4 lon, 5 E/W, 6 quality, 7 satellites
+   */
+  int field = m_field;
+  if ((m_sentence == st_GGA) && (field >= 2)) {
+    field = (field <= 5) ? (field + 1) : (field + 10); // align lat..E/W with RMC; quality etc. after
+  }
+  Fix & F = m_pending;
+
+  switch (field) {
+  case 1: // hhmmss.sss
+    {
+      unsigned long t = s_scale(m_value, m_decimals, 3);
+      F.hour         = (uint8_t) (t / 10000000UL);
+      F.minute       = (uint8_t) ((t / 100000UL) % 100);
+      F.seconds      = (uint8_t) ((t / 1000UL) % 100);
+      F.milliseconds = (uint16_t) (t % 1000);
+    }
+    break;
+  case 2: // RMC status
+    F.fix = (m_char == 'A');
+    break;
+  case 3:
+    F.latitude = s_degrees(m_value, m_decimals);
+    break;
+  case 4:
+    if ((m_char == 'S') == (F.latitude > 0)) {
+      F.latitude = -F.latitude;
+    }
+    break;
+  case 5:
+    F.longitude = s_degrees(m_value, m_decimals);
+    break;
+  case 6:
+    if ((m_char == 'W') == (F.longitude > 0)) {
+      F.longitude = -F.longitude;
+    }
+    break;
+  case 9: // ddmmyy
+    F.day   = (uint8_t) (m_value / 10000);
+    F.month = (uint8_t) ((m_value / 100) % 100);
+    F.year  = (uint8_t) (m_value % 100);
+    break;
+  case 16: // GGA quality
+    F.fix = (m_value > 0);
+    break;
+  case 17: // GGA satellites
+    F.satellites = (uint8_t) m_value;
+    break;
+  default:
+    break;
+  }
+}
+
+bool NMEA::put(char c) {
+  if (c == '$') { // always starts a new sentence, even if the last was incomplete
+    m_state = ns_Field;
+    m_sum = 0;
+    m_field = 0;
+    m_id = 0;
+    m_pending = m_fix;
+    begin_field();
+    return false;
+  }
+
+  switch (m_state) {
+  case ns_Field:
+    if (c == '*') {
+      end_field();
+      m_state = ns_Check1;
+    } else if (c == ',') {
+      m_sum ^= c;
+      end_field();
+      if (++m_field > NMEA_FIELDS) {
+        m_sentence = st_Other;
+      }
+      begin_field();
+    } else if (c == '\r' || c == '\n') { // no checksum
+      ++m_stats.errors;
+      m_state = ns_Idle;
+    } else {
+      m_sum ^= c;
+      m_bEmpty = false;
+
+      if (m_field == 0) {
+        m_id = ((m_id << 8) | (unsigned char) c) & 0xFFFFFFUL;
+      } else if (c >= '0' && c <= '9') {
+        if (!m_bPoint) {
+          m_value = m_value * 10 + (c - '0');
+        } else if (m_decimals < NMEA_DECIMALS) {
+          m_value = m_value * 10 + (c - '0');
+          ++m_decimals;
+        }
+      } else if (c == '.') {
+        m_bPoint = true;
+      } else if (!m_char) {
+        m_char = c;
+      }
+    }
+    break;
+
+  case ns_Check1:
+  case ns_Check2:
+    {
+      int digit = s_hex(c);
+      if (digit < 0) {
+        ++m_stats.errors;
+        m_state = ns_Idle;
+        break;
+      }
+      if (m_state == ns_Check1) {
+        m_check = (uint8_t) (digit << 4);
+        m_state = ns_Check2;
+        break;
+      }
+      m_check |= (uint8_t) digit;
+      m_state = ns_Idle;
+
+      if (m_check != m_sum) {
+        ++m_stats.errors;
+      } else if (m_sentence == st_Other) {
+        ++m_stats.ignored;
+      } else {
+        m_fix = m_pending;
+        ++m_stats.sentences;
+        return true;
+      }
+    }
+    break;
+
+  default: // ns_Idle: between sentences
+    break;
+  }
+  return false;
+}
+
+int NMEA::drain(Stream & stream) {
+  int count = 0;
+  int available = stream.available();
+
+  while (available-- > 0) {
+    if (put((char) stream.read())) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+#endif // ENABLE_GPS
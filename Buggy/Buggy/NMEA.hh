@@ -0,0 +1,106 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_NMEA_hh
+#define cariot_NMEA_hh
+
+#define NMEA_DECIMALS 5  // decimal places kept of any number; minutes of latitude & longitude need five
+#define NMEA_FIELDS   20 // fields beyond this are ignored
+
+/* NMEA parses RMC & GGA sentences a character at a time, as they arrive, without keeping the sentence: each
+ * field is converted as it ends, into a pending fix, and the pending fix becomes the current fix only if the
+ * sentence's checksum is correct. Other sentences are checked and ignored. Latitude & longitude are kept as
+ * integers, in units of 10^-7 degrees, so that no precision is lost to float.
+ */
+class NMEA {
+public:
+  struct Fix {
+    uint8_t  hour;
+    uint8_t  minute;
+    uint8_t  seconds;
+    uint16_t milliseconds;
+    uint8_t  day;
+    uint8_t  month;
+    uint8_t  year;       // since 2000
+    bool     fix;        // RMC status A, or GGA quality > 0
+    uint8_t  satellites; // from GGA
+    long     latitude;   // degrees x 10^7, north positive
+    long     longitude;  // degrees x 10^7, east positive
+  };
+
+  struct Stats {
+    unsigned long sentences; // RMC & GGA sentences accepted
+    unsigned long errors;    // bad or missing checksum
+    unsigned long ignored;   // other sentences
+  };
+
+private:
+  enum State {
+    ns_Idle = 0, // waiting for '$'
+    ns_Field,
+    ns_Check1,   // first checksum digit
+    ns_Check2
+  };
+  enum Sentence {
+    st_Other = 0,
+    st_RMC,
+    st_GGA
+  };
+
+  Fix   m_fix;
+  Fix   m_pending;
+  Stats m_stats;
+
+  unsigned long m_id;    // last three characters of the address field, e.g., "RMC"
+  unsigned long m_value; // digits of the current field, without the decimal point
+  uint8_t m_decimals;    // number of digits after the decimal point
+  uint8_t m_state;
+  uint8_t m_sentence;
+  uint8_t m_field;
+  uint8_t m_sum;         // running checksum
+  uint8_t m_check;       // checksum as received
+  char    m_char;        // the first non-digit in the current field, if any
+  bool    m_bPoint;
+  bool    m_bEmpty;
+
+  static unsigned long s_scale(unsigned long value, int decimals, int target);
+  static long s_degrees(unsigned long value, int decimals);
+  static int  s_hex(char c);
+
+  void begin_field();
+  void end_field();
+
+public:
+  NMEA();
+
+  ~NMEA() {
+    // ...
+  }
+
+  /* Parse one character; returns true if it completed a valid RMC or GGA sentence
+   */
+  bool put(char c);
+
+  /* Parse everything waiting in the stream; returns the number of valid RMC & GGA sentences completed
+   */
+  int drain(Stream & stream);
+
+  inline const Fix & fix() const {
+    return m_fix;
+  }
+  inline float latitude_degrees() const {
+    return (float) m_fix.latitude / 1E7;
+  }
+  inline float longitude_degrees() const {
+    return (float) m_fix.longitude / 1E7;
+  }
+
+  inline const Stats & stats() const {
+    return m_stats;
+  }
+  void clear();
+};
+
+#endif /* !cariot_NMEA_hh */
@@ -0,0 +1,89 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_PID_hh
+#define cariot_PID_hh
+
+#define PID_INTEGRAL_MS 100 // the integral is kept in units of error x 100 ms, to suit the range of Q16.16
+
+/** PID is a discrete PID controller over a number type T, either float or Fixed (Q16.16). The integral
+ * uses the trapezoid rule and the derivative a backward difference, as before, but the interval is folded
+ * into the coefficients - D/dt and dt/2 - when the gains or the interval change, so that update() itself
+ * is three multiplies and no division. The gains are as they are set by command, in units of milliseconds.
+ */
+template <typename T>
+class PID {
+private:
+  T m_kp;       // P
+  T m_ki;       // I, per PID_INTEGRAL_MS
+  T m_kd;       // D / dt
+  T m_half_dt;  // dt / 2, in units of PID_INTEGRAL_MS
+
+  T m_error_old;
+  T m_integral;
+
+  float m_P;    // the gains and interval the coefficients were last computed for
+  float m_I;
+  float m_D;
+  float m_dt_ms;
+
+public:
+  PID() :
+    m_kp(0),
+    m_ki(0),
+    m_kd(0),
+    m_half_dt(0),
+    m_error_old(0),
+    m_integral(0),
+    m_P(0),
+    m_I(0),
+    m_D(0),
+    m_dt_ms(0)
+  {
+    // ...
+  }
+
+  ~PID() {
+    // ...
+  }
+
+  /* Set the gains and the interval (in milliseconds); does nothing unless one of them has changed
+   */
+  void tune(float P, float I, float D, float dt_ms) {
+    if ((P == m_P) && (I == m_I) && (D == m_D) && (dt_ms == m_dt_ms)) {
+      return;
+    }
+    if (dt_ms <= 0) {
+      return;
+    }
+    m_P = P;
+    m_I = I;
+    m_D = D;
+    m_dt_ms = dt_ms;
+
+    m_kp = T(P);
+    m_ki = T(I * (float) PID_INTEGRAL_MS);
+    m_kd = T(D / dt_ms);
+    m_half_dt = T(dt_ms / (float) (2 * PID_INTEGRAL_MS));
+  }
+
+  /* Forget the integral & the previous error
+   */
+  void reset() {
+    m_error_old = T(0);
+    m_integral = T(0);
+  }
+
+  T update(T error) {
+    m_integral += (error + m_error_old) * m_half_dt;
+
+    T estimate = m_kp * error + m_ki * m_integral + m_kd * (error - m_error_old);
+
+    m_error_old = error;
+    return estimate;
+  }
+};
+
+#endif /* !cariot_PID_hh */
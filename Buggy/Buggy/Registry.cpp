@@ -0,0 +1,86 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#include "config.hh"
+#include "Registry.hh"
+
+void Registry::Param::set(unsigned long value) const {
+  if (value < min) {
+    value = min;
+  } else if (value > max) {
+    value = max;
+  }
+  switch (type) {
+  case pt_Float:
+    *target.f = (float) value / (float) scale;
+    break;
+  case pt_Int:
+    *target.i = (int) value;
+    break;
+  case pt_Bool:
+    *target.b = value ? true : false;
+    break;
+  }
+}
+
+unsigned long Registry::Param::get() const {
+  switch (type) {
+  case pt_Float:
+    {
+      float value = *target.f * (float) scale;
+      return (value > 0) ? (unsigned long) (value + 0.5f) : 0;
+    }
+  case pt_Int:
+    return (*target.i > 0) ? (unsigned long) *target.i : 0;
+  case pt_Bool:
+    return *target.b ? 1 : 0;
+  }
+  return 0;
+}
+
+Registry::Registry(const Param * params, int count) :
+  m_params(params),
+  m_count(count)
+{
+  for (int i = 0; i < index_size; i++) {
+    m_index[i] = -1;
+  }
+  for (int p = 0; p < count; p++) {
+    int i = params[p].code - 'A';
+    if (i >= 0 && i < index_size) {
+      m_index[i] = (signed char) p;
+    }
+  }
+}
+
+bool Registry::set(char code, unsigned long value) const {
+  const Param * p = find(code);
+  if (p) {
+    p->set(value);
+  }
+  return p != 0;
+}
+
+void Registry::reply(Commander * C, const Param & p) const {
+  C->command_send('K', (unsigned long) p.code);
+  C->command_send('U', p.scale);
+  C->command_send('L', p.min);
+  C->command_send('H', p.max);
+  C->command_send('V', p.get());
+}
+
+void Registry::get(Commander * C, unsigned long value) const {
+  if (!value) {
+    for (int p = 0; p < m_count; p++) {
+      reply(C, m_params[p]);
+    }
+    C->command_send('K', 0);
+  } else {
+    const Param * p = find((char) (value & 0x7F));
+    if (p) {
+      reply(C, *p);
+    }
+  }
+}
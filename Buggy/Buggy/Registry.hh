@@ -0,0 +1,90 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_Registry_hh
+#define cariot_Registry_hh
+
+#include "Commander.hh"
+
+/* Registry maps command codes to parameters, each with a target variable, a scale and a range, so that
+ * a parameter can be set with its own code (e.g., "P150," sets P = 1.50) and read back with:
+ *
+ *   "G<c>,"  where c is the ASCII value of the code; or "G0," for all parameters
+ *
+ * The reply for each parameter is "K<c>,U<scale>,L<min>,H<max>,V<value>," where min, max & value are
+ * raw (unscaled) command values; an enumeration ends with "K0,".
+ */
+class Registry {
+public:
+  class Param {
+  public:
+    enum Type {
+      pt_Float = 0,
+      pt_Int,
+      pt_Bool
+    };
+
+    union Target {
+      float * f;
+      int   * i;
+      bool  * b;
+
+      constexpr Target(float * ptr) : f(ptr) { }
+      constexpr Target(int   * ptr) : i(ptr) { }
+      constexpr Target(bool  * ptr) : b(ptr) { }
+    };
+
+    char          code;
+    unsigned char type;
+    Target        target;
+    unsigned long scale; // i.e., raw command value = actual value * scale
+    unsigned long min;   // range of raw command values
+    unsigned long max;
+
+    constexpr Param(char c, float * f, unsigned long s, unsigned long lo, unsigned long hi) :
+      code(c), type(pt_Float), target(f), scale(s), min(lo), max(hi) { }
+    constexpr Param(char c, int * i, unsigned long lo, unsigned long hi) :
+      code(c), type(pt_Int), target(i), scale(1), min(lo), max(hi) { }
+    constexpr Param(char c, bool * b) :
+      code(c), type(pt_Bool), target(b), scale(1), min(0), max(1) { }
+
+    void set(unsigned long value) const;
+    unsigned long get() const;
+  };
+
+private:
+  static const int index_size = 'z' - 'A' + 1;
+
+  const Param * m_params;
+  int           m_count;
+  signed char   m_index[index_size]; // code - 'A' => index in m_params, or -1
+
+  void reply(Commander * C, const Param & p) const;
+
+public:
+  Registry(const Param * params, int count);
+
+  ~Registry() {
+    // ...
+  }
+
+  const Param * find(char code) const {
+    int i = code - 'A';
+    if (i < 0 || i >= index_size || m_index[i] < 0) {
+      return 0;
+    }
+    return m_params + m_index[i];
+  }
+
+  /* Returns false if the code isn't registered
+   */
+  bool set(char code, unsigned long value) const;
+
+  /* Handle a "G" request received from C; replies are sent back to C
+   */
+  void get(Commander * C, unsigned long value) const;
+};
+
+#endif /* !cariot_Registry_hh */
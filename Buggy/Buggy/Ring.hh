@@ -0,0 +1,205 @@
+/* Copyright 2018-21 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_Ring_hh
+#define cariot_Ring_hh
+
+#include <string.h>
+
+/** Ring is a first-in first-out buffer of N items, where N must be a power of two.
+ *
+ * The head and tail are free-running counters, masked only to index the buffer, so that full and empty
+ * are simply head - tail == N and head == tail, and all N items are usable. The producer alone writes the
+ * head and the consumer alone writes the tail, each with release ordering, and each reads the other's
+ * index with acquire ordering; so one producer (e.g., an interrupt) and one consumer (e.g., the main loop)
+ * may use the ring concurrently without disabling interrupts.
+ */
+template <typename T, unsigned N>
+class Ring {
+private:
+  static_assert(N && !(N & (N - 1)), "Ring: N must be a power of two");
+
+  static const unsigned mask = N - 1;
+
+  T        m_buffer[N]; ///< The buffer.
+  unsigned m_head;      ///< Number of items ever pushed; written by the producer only.
+  unsigned m_tail;      ///< Number of items ever popped; written by the consumer only.
+
+  static inline unsigned s_acquire(const unsigned & index) {
+    return __atomic_load_n(&index, __ATOMIC_ACQUIRE);
+  }
+  static inline unsigned s_relaxed(const unsigned & index) {
+    return __atomic_load_n(&index, __ATOMIC_RELAXED);
+  }
+  static inline void s_release(unsigned & index, unsigned value) {
+    __atomic_store_n(&index, value, __ATOMIC_RELEASE);
+  }
+
+public:
+  Ring () :
+    m_head(0),
+    m_tail(0)
+  {
+    // ...
+  }
+
+  ~Ring () {
+    // ...
+  }
+
+  /** Discard the contents; consumer side.
+   */
+  inline void clear () {
+    s_release(m_tail, s_acquire(m_head));
+  }
+
+  /** Returns true if the buffer is empty.
+   */
+  inline bool is_empty () const {
+    return s_acquire(m_head) == s_acquire(m_tail);
+  }
+
+  /** Add an item to the buffer; returns true if there was space. Producer side.
+   */
+  inline bool push (T item) {
+    unsigned head = s_relaxed(m_head);
+
+    if (head - s_acquire(m_tail) == N) {
+      return false;
+    }
+    m_buffer[head & mask] = item;
+    s_release(m_head, head + 1);
+    return true;
+  }
+
+  /** Remove an item from the buffer; returns true if the buffer wasn't empty. Consumer side.
+   */
+  inline bool pop (T & item) {
+    unsigned tail = s_relaxed(m_tail);
+
+    if (s_acquire(m_head) == tail) {
+      return false;
+    }
+    item = m_buffer[tail & mask];
+    s_release(m_tail, tail + 1);
+    return true;
+  }
+
+  /** Read (and remove) multiple items from the buffer. Consumer side.
+   * \param ptr    Pointer to an external array where the data should be written.
+   * \param length Number of items to read from the buffer, if possible.
+   * \return The number of items actually read from the buffer.
+   */
+  int read (T * ptr, int length) {
+    if (!ptr || length <= 0) {
+      return 0;
+    }
+    unsigned tail  = s_relaxed(m_tail);
+    unsigned count = s_acquire(m_head) - tail;
+
+    if (count > (unsigned) length) {
+      count = (unsigned) length;
+    }
+    unsigned start = tail & mask;
+    unsigned first = N - start;            // i.e., items before the wrap-around
+
+    if (first > count) {
+      first = count;
+    }
+    memcpy (ptr, m_buffer + start, first * sizeof(T));
+    memcpy (ptr + first, m_buffer, (count - first) * sizeof(T));
+
+    s_release(m_tail, tail + count);
+    return (int) count;
+  }
+
+  /** Write multiple items to the buffer. Producer side.
+   * \param ptr    Pointer to an external array where the data should be read from.
+   * \param length Number of items to write to the buffer, if possible.
+   * \return The number of items actually written to the buffer.
+   */
+  int write (const T * ptr, int length) {
+    if (!ptr || length <= 0) {
+      return 0;
+    }
+    unsigned head  = s_relaxed(m_head);
+    unsigned count = N - (head - s_acquire(m_tail)); // i.e., free space
+
+    if (count > (unsigned) length) {
+      count = (unsigned) length;
+    }
+    unsigned start = head & mask;
+    unsigned first = N - start;            // i.e., space before the wrap-around
+
+    if (first > count) {
+      first = count;
+    }
+    memcpy (m_buffer + start, ptr, first * sizeof(T));
+    memcpy (m_buffer, ptr + first, (count - first) * sizeof(T));
+
+    s_release(m_head, head + count);
+    return (int) count;
+  }
+
+  /** Zero-copy read: the longest contiguous run of items at the front of the buffer. Consumer side.
+   * \param ptr Set to the first item; valid until consume() is called.
+   * \return The number of items in the run; zero if empty. Call again after consume() for any remainder.
+   */
+  int peek_span (const T *& ptr) const {
+    unsigned tail  = s_relaxed(m_tail);
+    unsigned count = s_acquire(m_head) - tail;
+    unsigned start = tail & mask;
+
+    if (count > N - start) {
+      count = N - start;
+    }
+    ptr = m_buffer + start;
+    return (int) count;
+  }
+
+  /** Remove count items, e.g., after peek_span(); count must not exceed available().
+   */
+  inline void consume (int count) {
+    s_release(m_tail, s_relaxed(m_tail) + (unsigned) count);
+  }
+
+  /** Zero-copy write: the longest contiguous run of free space. Producer side.
+   * \param ptr Set to the first free item, to be filled before commit().
+   * \return The number of items that may be written; zero if full.
+   */
+  int reserve_span (T *& ptr) {
+    unsigned head  = s_relaxed(m_head);
+    unsigned count = N - (head - s_acquire(m_tail));
+    unsigned start = head & mask;
+
+    if (count > N - start) {
+      count = N - start;
+    }
+    ptr = m_buffer + start;
+    return (int) count;
+  }
+
+  /** Publish count items written after reserve_span(); count must not exceed the reserved length.
+   */
+  inline void commit (int count) {
+    s_release(m_head, s_relaxed(m_head) + (unsigned) count);
+  }
+
+  /** Number of items in the buffer.
+   */
+  int available () const {
+    unsigned tail  = s_acquire(m_tail); // tail first, so that head - tail can't underflow
+    unsigned count = s_acquire(m_head) - tail;
+    return (int) ((count > N) ? N : count);
+  }
+
+  /** Number of items that can be added to the buffer.
+   */
+  int availableToWrite () const {
+    return (int) N - available();
+  }
+};
+
+#endif /* !cariot_Ring_hh */
@@ -0,0 +1,174 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_Scheduler_hh
+#define cariot_Scheduler_hh
+
+/** Scheduler is a small, static, cooperative scheduler: each task has a period, a priority and a deadline
+ * (relative to its release time). When several tasks are due, the one with the highest priority runs first,
+ * and then the one with the earliest deadline. A task runs to completion, so a slow task can't be interrupted,
+ * but its effect on others is recorded: lateness is the delay between release and start, and an overrun is
+ * a run that finishes after its deadline. If a run finishes after the task's next release, the releases it
+ * has missed are skipped (and counted) rather than run back to back.
+ *
+ * Times are in microseconds from now(), a free-running clock that may wrap around; the clock is supplied by
+ * a subclass, e.g., micros() in firmware or a virtual clock for simulation on a host.
+ */
+class Scheduler {
+public:
+  class Job {
+  public:
+    virtual void job(int id) = 0;
+
+    virtual ~Job() { }
+  };
+
+  struct Stats {
+    unsigned long runs;         // number of times the task has run
+    unsigned long late;         // number of runs that started after the deadline
+    unsigned long overruns;     // number of runs that finished after the deadline
+    unsigned long skipped;      // number of releases skipped because the task fell a period behind
+    unsigned long lateness_max; // maximum delay between release and start
+  };
+
+private:
+  struct Task {
+    Job *         job;
+    int           id;
+    unsigned long period;
+    unsigned long deadline;
+    unsigned long release;  // next release time
+    unsigned char priority; // higher runs first
+    Stats         stats;
+  };
+
+  Task m_task[SCHEDULER_TASKS_MAX];
+  int  m_count;
+
+  static inline bool s_due(unsigned long now, unsigned long t) { // i.e., now >= t, allowing for wrap-around
+    return (long) (now - t) >= 0;
+  }
+
+public:
+  Scheduler() :
+    m_count(0)
+  {
+    // ...
+  }
+
+  virtual ~Scheduler() {
+    // ...
+  }
+
+  virtual unsigned long now() = 0; // the clock, in microseconds
+
+  /* Add a task, first released one period from now; returns the task index, or -1 if there's no space
+   */
+  int add(Job * job, int id, unsigned long period, unsigned long deadline, unsigned char priority) {
+    if (!job || !period || m_count == SCHEDULER_TASKS_MAX) {
+      return -1;
+    }
+    Task & T = m_task[m_count];
+
+    T.job      = job;
+    T.id       = id;
+    T.period   = period;
+    T.deadline = deadline ? deadline : period;
+    T.release  = now() + period;
+    T.priority = priority;
+
+    clear(m_count);
+    return m_count++;
+  }
+
+  inline int count() const {
+    return m_count;
+  }
+  inline const Stats & stats(int index) const {
+    return m_task[index].stats;
+  }
+  inline int id(int index) const {
+    return m_task[index].id;
+  }
+  void clear(int index) {
+    Stats & S = m_task[index].stats;
+    S.runs = 0;
+    S.late = 0;
+    S.overruns = 0;
+    S.skipped = 0;
+    S.lateness_max = 0;
+  }
+
+  /* Time until the next release, or 0 if a task is due now
+   */
+  unsigned long until_next() {
+    unsigned long t = now();
+    unsigned long wait = ~0UL;
+
+    for (int i = 0; i < m_count; i++) {
+      if (s_due(t, m_task[i].release)) {
+        return 0;
+      }
+      unsigned long w = m_task[i].release - t;
+      if (w < wait) {
+        wait = w;
+      }
+    }
+    return wait;
+  }
+
+  /* Run the most urgent task that is due, if any; returns false if there was nothing to do
+   */
+  bool step() {
+    unsigned long t = now();
+    int next = -1;
+
+    for (int i = 0; i < m_count; i++) {
+      const Task & T = m_task[i];
+      if (!s_due(t, T.release)) {
+        continue;
+      }
+      if (next < 0) {
+        next = i;
+        continue;
+      }
+      const Task & N = m_task[next];
+      if ((T.priority > N.priority) ||
+          ((T.priority == N.priority) && ((long) ((T.release + T.deadline) - (N.release + N.deadline)) < 0))) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      return false;
+    }
+    Task & T = m_task[next];
+
+    unsigned long lateness = t - T.release;
+    if (lateness > T.stats.lateness_max) {
+      T.stats.lateness_max = lateness;
+    }
+    if (lateness > T.deadline) {
+      ++T.stats.late;
+    }
+
+    T.job->job(T.id);
+    ++T.stats.runs;
+
+    unsigned long finish = now();
+    if (finish - T.release > T.deadline) {
+      ++T.stats.overruns;
+    }
+
+    T.release += T.period;
+    if (s_due(finish, T.release)) { // a period or more behind; skip to the first release after this run
+      unsigned long missed = (finish - T.release) / T.period + 1;
+      T.stats.skipped += missed;
+      T.release += missed * T.period;
+    }
+    return true;
+  }
+};
+
+#endif /* !cariot_Scheduler_hh */
@@ -0,0 +1,68 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#ifndef cariot_SeqLock_hh
+#define cariot_SeqLock_hh
+
+/** SeqLock holds a value of type T that one writer (e.g., an interrupt) updates in place and any reader
+ * copies out without disabling interrupts. The writer makes the sequence number odd while it updates the
+ * value and even again after; a reader retries if the number was odd, or changed, while it was copying.
+ * The writer never waits, and a reader only repeats the copy if the writer ran in the middle of it.
+ */
+template <typename T>
+class SeqLock {
+private:
+  T        m_value;
+  unsigned m_sequence;
+
+public:
+  SeqLock () :
+    m_value(),
+    m_sequence(0)
+  {
+    // ...
+  }
+
+  ~SeqLock () {
+    // ...
+  }
+
+  /** Start an update; writer side. Modify the value through the reference, then call write_end().
+   */
+  inline T & write_begin () {
+    __atomic_store_n(&m_sequence, __atomic_load_n(&m_sequence, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); // the odd sequence is visible before any change to the value...
+    __asm__ volatile ("" ::: "memory");      // ... and the compiler mustn't move those changes above it
+    return m_value;
+  }
+
+  /** Finish an update; writer side.
+   */
+  inline void write_end () {
+    __atomic_store_n(&m_sequence, __atomic_load_n(&m_sequence, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+  }
+
+  /** A consistent copy of the value; reader side.
+   * \return The number of attempts that were needed.
+   */
+  int read (T & value) const {
+    int attempts = 0;
+    unsigned before;
+    unsigned after;
+
+    do {
+      ++attempts;
+      before = __atomic_load_n(&m_sequence, __ATOMIC_ACQUIRE);
+      value = m_value;
+      __asm__ volatile ("" ::: "memory");
+      __atomic_thread_fence(__ATOMIC_ACQUIRE); // the copy is complete before the sequence is checked
+      after = __atomic_load_n(&m_sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || (before != after));
+
+    return attempts;
+  }
+};
+
+#endif /* !cariot_SeqLock_hh */
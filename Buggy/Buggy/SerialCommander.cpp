@@ -7,7 +7,7 @@
 #include "SerialCommander.hh"
 
 SerialCommander::SerialCommander(Stream & HS, char identifier, Commander::Responder * R) :
-  Commander(R),
+  Commander(R, ct_Serial0 + (identifier - '0')),
   m_serial(&HS)
 {
   m_id[0] = 's';
@@ -24,13 +24,26 @@ const char * SerialCommander::name() const {
 }
 
 void SerialCommander::update() {
-  while (m_serial->available()) {
-    push((char) m_serial->read());
+  int count = m_serial->available();
+
+  while (count > 0) {
+    char buffer[64];
+    int length = m_serial->readBytes(buffer, (count < 64) ? count : 64);
+    if (length <= 0) break;
+    push(buffer, length);
+    count -= length;
   }
-  while (m_serial->availableForWrite()) {
-    char c;
-    if (!m_fifo.pop(c)) break;
-    m_serial->write(c);
+
+  const char * span;
+  while ((count = m_fifo.peek_span(span))) { // at most twice, if the data wraps around
+    int space = m_serial->availableForWrite();
+    if (space <= 0) break;
+    if (count > space) {
+      count = space;
+    }
+    int written = (int) m_serial->write(span, count);
+    if (written <= 0) break;
+    m_fifo.consume(written);
   }
 }
 
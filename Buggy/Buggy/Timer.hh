@@ -6,21 +6,160 @@
 #ifndef cariot_Timer_hh
 #define cariot_Timer_hh
 
-class Timer {
+#include "Scheduler.hh"
+
+#define TIMER_PROFILE_MAX  SCHEDULER_TASKS_MAX // tasks with ID < TIMER_PROFILE_MAX can be profiled
+#define TIMER_PROFILE_BINS 8                   // histogram: < 10us, 30us, 100us, 300us, 1ms, 3ms, 10ms, and longer
+#define TIMER_IDLE_MIN     200                 // don't sleep unless the next task is at least this many microseconds away
+
+/* Timer runs the standard every_milli/every_10ms/every_tenth/every_second callbacks as scheduler tasks;
+ * further tasks may be added with schedule(), and tick() is called whenever no task is due.
+ */
+class Timer : public Scheduler, public Scheduler::Job {
+public:
+  enum TaskID {
+    ti_Milli = 0,
+    ti_10ms,
+    ti_Tenth,
+    ti_Second,
+    ti_User // first ID for tasks added with schedule()
+  };
+
+  struct Idle {        // time spent asleep, and how late the core woke for the next task, in microseconds
+    unsigned long count;
+    unsigned long asleep;
+    unsigned long wakes; // number of sleeps that ended at or after the next release
+    unsigned long wake_sum;
+    unsigned long wake_max;
+  };
+
+  struct Profile {     // execution time of a task's callback, in microseconds
+    unsigned long count;
+    unsigned long min;
+    unsigned long max;
+    unsigned long sum;
+    unsigned long bins[TIMER_PROFILE_BINS];
+  };
+
 private:
+  Profile m_profile[TIMER_PROFILE_MAX];
+  Idle    m_idle;
+
+  int m_tenth;
   bool m_stop;
+  bool m_bTasks; // the 10ms/milli/tenth/second tasks have been added
+  bool m_bProfile;
+  bool m_bIdle;
+
+  /* Sleep the core until the next interrupt; any interrupt will do - serial, radio, encoder, or the
+   * millisecond system tick, which bounds the sleep and so the lateness of the next task
+   */
+  static inline void s_idle_wait() {
+#if defined(__arm__)
+    __asm__ volatile ("wfi");
+#else
+    yield();
+#endif
+  }
+
+  void idle_wait(unsigned long wait) {
+    unsigned long start = now();
+    s_idle_wait();
+    unsigned long asleep = now() - start;
+
+    ++m_idle.count;
+    m_idle.asleep += asleep;
+
+    if (asleep >= wait) {
+      unsigned long latency = asleep - wait;
+      ++m_idle.wakes;
+      m_idle.wake_sum += latency;
+      if (latency > m_idle.wake_max) {
+        m_idle.wake_max = latency;
+      }
+    }
+  }
+
+  /* The clock for profiling: the cycle counter on Teensy, otherwise micros()
+   */
+  static inline unsigned long s_profile_clock() {
+#if defined(TEENSYDUINO) && defined(ARM_DWT_CYCCNT)
+    return ARM_DWT_CYCCNT;
+#else
+    return micros();
+#endif
+  }
+  static inline unsigned long s_profile_us(unsigned long ticks) {
+#if defined(TEENSYDUINO) && defined(ARM_DWT_CYCCNT)
+    return ticks / (F_CPU / 1000000);
+#else
+    return ticks;
+#endif
+  }
+
+  void profile_record(int id, unsigned long us) {
+    static const unsigned long s_bin_max[TIMER_PROFILE_BINS - 1] = { 10, 30, 100, 300, 1000, 3000, 10000 };
+
+    Profile & P = m_profile[id];
+
+    if (!P.count || us < P.min) {
+      P.min = us;
+    }
+    if (us > P.max) {
+      P.max = us;
+    }
+    ++P.count;
+    P.sum += us;
+
+    int b = 0;
+    while ((b < TIMER_PROFILE_BINS - 1) && (us >= s_bin_max[b])) {
+      ++b;
+    }
+    ++P.bins[b];
+  }
+
+  void dispatch(int id) {
+    switch (id) {
+    case ti_Milli:
+      every_milli();
+      break;
+    case ti_10ms:
+      every_10ms();
+      break;
+    case ti_Tenth:
+      every_tenth(m_tenth);
+      if (++m_tenth == 10) {
+        m_tenth = 0;
+      }
+      break;
+    case ti_Second:
+      every_second();
+      break;
+    default:
+      every(id);
+      break;
+    }
+  }
 
 public:
   Timer() :
-    m_stop(false)
+    m_tenth(0),
+    m_stop(false),
+    m_bTasks(false),
+    m_bProfile(false),
+    m_bIdle(false)
   {
-    // ...
+    profile_clear();
   }
 
   virtual ~Timer() {
     // ...
   }
 
+  virtual unsigned long now() {
+    return micros();
+  }
+
   virtual void every_milli() { // runs once a millisecond, on average
     // ...
   }
@@ -33,44 +172,99 @@ public:
   virtual void every_second() { // runs once every second
     // ...
   }
+  virtual void every(int id) { // runs a task added with schedule()
+    // ...
+  }
   virtual void tick() {
     // ...
   }
 
-  inline void stop() {
-    m_stop = true;
+  /* Add a task with ID >= ti_User; period & deadline in microseconds; returns the task index, or -1
+   */
+  inline int schedule(int id, unsigned long period, unsigned long deadline, unsigned char priority) {
+    return add(this, id, period, deadline, priority);
   }
-  void run() {
-    int count_ms = 0;
-    int count_10ms = 0;
-    int count_tenths = 0;
 
-    unsigned long previous_time = millis();
-
-    m_stop = false;
+  virtual void job(int id) {
+    if (m_bProfile && (id < TIMER_PROFILE_MAX)) {
+      unsigned long start = s_profile_clock();
+      dispatch(id);
+      profile_record(id, s_profile_us(s_profile_clock() - start));
+    } else {
+      dispatch(id);
+    }
+  }
 
-    while (!m_stop) {
-      tick();
+  /* Profiling is off by default; when off, the only cost is a test per callback
+   */
+  void profile(bool bEnable) {
+#if defined(TEENSYDUINO) && defined(ARM_DWT_CYCCNT)
+    if (bEnable) { // make sure the cycle counter is running
+      ARM_DEMCR |= ARM_DEMCR_TRCENA;
+      ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+    }
+#endif
+    m_bProfile = bEnable;
+  }
+  inline bool profiling() const {
+    return m_bProfile;
+  }
+  inline const Profile & profile_of(int id) const {
+    return m_profile[id];
+  }
+  /* Tickless idle: when no task is due, call tick() and then sleep until an interrupt, unless the next task is
+   * due within TIMER_IDLE_MIN; tick() is then called at least once a millisecond, rather than continuously
+   */
+  inline void idle(bool bEnable) {
+    m_bIdle = bEnable;
+  }
+  inline bool idling() const {
+    return m_bIdle;
+  }
+  inline const Idle & idle_stats() const {
+    return m_idle;
+  }
 
-      // our little internal real-time clock:
-      unsigned long current_time = millis();
+  void profile_clear() {
+    m_idle.count = 0;
+    m_idle.asleep = 0;
+    m_idle.wakes = 0;
+    m_idle.wake_sum = 0;
+    m_idle.wake_max = 0;
 
-      if (current_time != previous_time) {
-        ++previous_time;
-        every_milli();
+    for (int id = 0; id < TIMER_PROFILE_MAX; id++) {
+      Profile & P = m_profile[id];
+      P.count = 0;
+      P.min = 0;
+      P.max = 0;
+      P.sum = 0;
+      for (int b = 0; b < TIMER_PROFILE_BINS; b++) {
+        P.bins[b] = 0;
+      }
+    }
+  }
 
-        if (++count_ms == 10) {
-          count_ms = 0;
-          every_10ms();
+  inline void stop() {
+    m_stop = true;
+  }
+  void run() {
+    if (!m_bTasks) { // the 10ms task, e.g., PID control, is the most urgent; the tenth & second tasks may be slow
+      m_bTasks = true;
+      add(this, ti_10ms,     10000UL,    2000UL, 3);
+      add(this, ti_Milli,     1000UL,    1000UL, 2);
+      add(this, ti_Tenth,   100000UL,  100000UL, 1);
+      add(this, ti_Second, 1000000UL, 1000000UL, 0);
+    }
+    m_stop = false;
 
-          if (++count_10ms == 10) {
-            count_10ms = 0;
-            every_tenth(count_tenths);
+    while (!m_stop) {
+      if (!step()) {
+        tick();
 
-            if (++count_tenths == 10) {
-              count_tenths = 0;
-              every_second();
-            }
+        if (m_bIdle) {
+          unsigned long wait = until_next();
+          if (wait >= TIMER_IDLE_MIN) {
+            idle_wait(wait);
           }
         }
       }
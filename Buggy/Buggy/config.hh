@@ -10,12 +10,14 @@
 
 //#define ENABLE_ROBOCLAW   // motor control using RoboClaw; comment to disable
 //#define ENABLE_PID        // PID motor control - experimental
+//#define ENABLE_PID_FIXED  // PID in Q16.16 fixed point rather than float; the default on cores without an FPU
 //#define ENABLE_BLUETOOTH  // required for Bluetooth; comment to disable
 //#define ENABLE_LORA       // required for LoRa; comment to disable
 //#define ENABLE_GPS        // required for GPS; comment to disable
 //#define ENABLE_JOYWING    // Feather JoyWing; comment to disable
 //#define ENABLE_ENCODERS   // use encoders
 //#define ENABLE_ENC_CLASS  // use Encoder class
+//#define ENABLE_IDLE       // sleep the core between tasks (tickless idle)
 //#define ENABLE_FEEDBACK   // echo received commands to Serial, if available // FIXME - collisions!
 
 #define TARGET_TRACKBUGGY   // Control circuit for the Track Buggy
@@ -34,6 +36,7 @@
 
 #ifdef APP_FORWARDING
 #define ENABLE_BLUETOOTH
+#define ENABLE_BRIDGE     // relay raw bytes between Serial1 and Serial/Bluetooth; comment to parse & re-send commands
 #endif
 
 #ifdef APP_MOTORCONTROL
@@ -42,6 +45,16 @@
 #define ENABLE_ENCODERS
 #define ENABLE_ENC_CLASS
 #define ENABLE_PID
+#define ENABLE_CONTROL_TIMER // run the control loop from an IntervalTimer interrupt; comment to run it from every_10ms()
+#endif
+
+#define CLAW_TELEMETRY_BUDGET 200000 // microseconds per second of RoboClaw bus time for telemetry reads
+
+#define CONTROL_PERIOD   1000 // microseconds between control cycles with ENABLE_CONTROL_TIMER; at least 1000 (1 kHz)
+#define CONTROL_PRIORITY  192 // control interrupt priority; must be lower (i.e., a higher number) than the encoder pins'
+
+#if defined(ENABLE_PID) && (defined(ADAFRUIT_FEATHER_M0) || defined(__ARM_ARCH_6M__))
+#define ENABLE_PID_FIXED  // Cortex-M0+ has no FPU, so float is all in software
 #endif
 
 #define LORA_ID_NONE_ALL  42
@@ -57,11 +70,13 @@
 
 #if defined(TARGET_JOYSTICK)
 #define ENABLE_LORA       // required for LoRa; comment to disable
+#define ENABLE_IDLE       // sleep between tasks to save battery; comment to disable
 #define LORA_ID_SELF    LORA_ID_JOYSTICK
 #define LORA_ID_PARTNER LORA_ID_ANTENNA
 #endif
 #if defined(TARGET_ANTENNA)
 #define ENABLE_LORA       // required for LoRa; comment to disable
+#define ENABLE_IDLE       // sleep between tasks to save battery; comment to disable
 #define LORA_ID_SELF    LORA_ID_ANTENNA
 #define LORA_ID_PARTNER LORA_ID_NONE_ALL // send to none, receive from all
 #endif
@@ -102,6 +117,9 @@ public:
 
 #endif
 
-#define FIFO_BUFSIZE 256
+#define COMMANDER_BUFSIZE 512 // Commander output buffer; must be a power of two
+#define COMMANDER_TEXT_MAX 128 // maximum length of a single text frame
+
+#define SCHEDULER_TASKS_MAX 8 // Timer uses four
 
 #endif /* !cariot_config_hh */
@@ -0,0 +1,984 @@
+/* Copyright (c) 2019 Francis James Franklin
+ * 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ * that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ *    the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *    the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <strings.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "Broker.hh"
+
+/* SHA-1 & base64, for the WebSocket handshake only
+ */
+static inline uint32_t s_rol(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+static void s_sha1_block(uint32_t * h, const unsigned char * block) {
+  uint32_t w[80];
+
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((uint32_t) block[4*i] << 24) | ((uint32_t) block[4*i+1] << 16) | ((uint32_t) block[4*i+2] << 8) | (uint32_t) block[4*i+3];
+  }
+  for (int i = 16; i < 80; i++) {
+    w[i] = s_rol(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+  }
+
+  uint32_t a = h[0];
+  uint32_t b = h[1];
+  uint32_t c = h[2];
+  uint32_t d = h[3];
+  uint32_t e = h[4];
+
+  for (int i = 0; i < 80; i++) {
+    uint32_t f;
+    uint32_t k;
+
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+    uint32_t t = s_rol(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = s_rol(b, 30);
+    b = a;
+    a = t;
+  }
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+static void s_sha1(const char * str, unsigned char * digest) {
+  uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+  size_t length = strlen(str);
+  size_t remaining = length;
+
+  const unsigned char * ptr = (const unsigned char *) str;
+
+  while (remaining >= 64) {
+    s_sha1_block(h, ptr);
+    ptr += 64;
+    remaining -= 64;
+  }
+
+  unsigned char block[128];
+  memset(block, 0, 128);
+  memcpy(block, ptr, remaining);
+  block[remaining] = 0x80;
+
+  int blocks = (remaining < 56) ? 1 : 2;
+
+  uint64_t bits = (uint64_t) length * 8;
+  for (int i = 0; i < 8; i++) {
+    block[64 * blocks - 1 - i] = (unsigned char) (bits >> (8 * i));
+  }
+  for (int i = 0; i < blocks; i++) {
+    s_sha1_block(h, block + 64 * i);
+  }
+  for (int i = 0; i < 5; i++) {
+    digest[4*i  ] = (unsigned char) (h[i] >> 24);
+    digest[4*i+1] = (unsigned char) (h[i] >> 16);
+    digest[4*i+2] = (unsigned char) (h[i] >>  8);
+    digest[4*i+3] = (unsigned char) (h[i]      );
+  }
+}
+
+static void s_base64(const unsigned char * bytes, int length, char * str) {
+  static const char * b64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  for (int i = 0; i < length; i += 3) {
+    uint32_t triple = (uint32_t) bytes[i] << 16;
+    if (i + 1 < length) triple |= (uint32_t) bytes[i+1] << 8;
+    if (i + 2 < length) triple |= (uint32_t) bytes[i+2];
+
+    *str++ = b64[(triple >> 18) & 0x3F];
+    *str++ = b64[(triple >> 12) & 0x3F];
+    *str++ = (i + 1 < length) ? b64[(triple >> 6) & 0x3F] : '=';
+    *str++ = (i + 2 < length) ? b64[triple & 0x3F] : '=';
+  }
+  *str = 0;
+}
+
+/* MQTT topic filter matching, with + and # wildcards
+ */
+static bool s_topic_match(const char * filter, const char * topic) {
+  while (*filter) {
+    if (*filter == '#') {
+      return true;
+    }
+    if (*filter == '+') {
+      while (*topic && *topic != '/') {
+	++topic;
+      }
+      ++filter;
+      continue;
+    }
+    if (!*topic && filter[0] == '/' && filter[1] == '#') { // "a/#" matches "a" too
+      return true;
+    }
+    if (*filter != *topic) {
+      return false;
+    }
+    ++filter;
+    ++topic;
+  }
+  return !*topic;
+}
+
+static const char * s_content_type(const char * path) {
+  const char * ext = strrchr(path, '.');
+
+  if (ext) {
+    if (strcmp(ext, ".html") == 0) return "text/html";
+    if (strcmp(ext, ".js")   == 0) return "application/javascript";
+    if (strcmp(ext, ".css")  == 0) return "text/css";
+    if (strcmp(ext, ".svg")  == 0) return "image/svg+xml";
+    if (strcmp(ext, ".png")  == 0) return "image/png";
+    if (strcmp(ext, ".jpg")  == 0) return "image/jpeg";
+    if (strcmp(ext, ".csv")  == 0) return "text/csv";
+  }
+  return "application/octet-stream";
+}
+
+Broker::Local::~Local() {
+  // ...
+}
+
+Broker::Broker(const char * webdir, int ws_port, int mqtt_port, bool verbose) :
+  m_local(0),
+  m_webdir(webdir),
+  m_local_pattern(0),
+  m_ws_fd(-1),
+  m_mqtt_fd(-1),
+  m_now(0),
+  m_verbose(verbose)
+{
+  for (int c = 0; c < BROKER_CONNECTIONS_MAX; c++) {
+    m_conn[c].type = Connection::ct_Free;
+    m_conn[c].fd = -1;
+    m_conn[c].file = -1;
+  }
+
+  m_ws_fd = listen_on(ws_port);
+  if (mqtt_port) {
+    m_mqtt_fd = listen_on(mqtt_port);
+  }
+}
+
+Broker::~Broker() {
+  for (int c = 0; c < BROKER_CONNECTIONS_MAX; c++) {
+    close(m_conn[c]);
+  }
+  if (m_ws_fd >= 0) {
+    ::close(m_ws_fd);
+  }
+  if (m_mqtt_fd >= 0) {
+    ::close(m_mqtt_fd);
+  }
+}
+
+int Broker::listen_on(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    fprintf(stderr, "broker: socket: %s\n", strerror(errno));
+    return -1;
+  }
+
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons((unsigned short) port);
+
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, 4)) {
+    fprintf(stderr, "broker: unable to listen on port %d: %s\n", port, strerror(errno));
+    ::close(fd);
+    return -1;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  if (m_verbose)
+    fprintf(stdout, "broker: listening on port %d\n", port);
+  return fd;
+}
+
+void Broker::accept_on(int fd, Connection::Type type) {
+  int cfd = accept(fd, 0, 0);
+  if (cfd < 0) {
+    return;
+  }
+
+  Connection * C = 0;
+
+  for (int c = 0; c < BROKER_CONNECTIONS_MAX; c++) {
+    if (m_conn[c].type == Connection::ct_Free) {
+      C = &m_conn[c];
+      break;
+    }
+  }
+  if (!C) {
+    if (m_verbose)
+      fprintf(stdout, "broker: too many connections - refusing\n");
+    ::close(cfd);
+    return;
+  }
+  fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+
+  C->type = type;
+  C->fd = cfd;
+  C->file = -1;
+  C->closing = false;
+  C->shut = false;
+  C->connected = false;
+  C->opened = m_now;
+  C->keepalive_ms = 0;
+  C->last_rx = m_now;
+  C->last_tx = m_now;
+  C->dropped = 0;
+  C->sub_count = 0;
+  C->rxlen = 0;
+  C->mqlen = 0;
+  C->txlen = 0;
+
+  if (m_verbose)
+    fprintf(stdout, "broker: [%d] %s connection\n", cfd, (type == Connection::ct_MQTT) ? "MQTT" : "HTTP");
+}
+
+void Broker::close(Connection & C) {
+  if (C.type == Connection::ct_Free) {
+    return;
+  }
+  if (m_verbose)
+    fprintf(stdout, "broker: [%d] closed (%lu messages dropped)\n", C.fd, C.dropped);
+
+  if (C.file >= 0) {
+    ::close(C.file);
+    C.file = -1;
+  }
+  ::close(C.fd);
+  C.fd = -1;
+  C.type = Connection::ct_Free;
+}
+
+bool Broker::tx_space(Connection & C, int length) {
+  return BROKER_TX_SIZE - C.txlen >= length;
+}
+
+bool Broker::tx_put(Connection & C, const void * bytes, int length) {
+  if (!tx_space(C, length)) {
+    return false;
+  }
+  memcpy(C.tx + C.txlen, bytes, length);
+  C.txlen += length;
+  return true;
+}
+
+void Broker::tx_flush(Connection & C) {
+  if (!C.txlen) {
+    return;
+  }
+  ssize_t count = send(C.fd, C.tx, C.txlen, MSG_NOSIGNAL);
+
+  if (count < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      close(C);
+    }
+    return;
+  }
+  if (count > 0) {
+    C.last_tx = m_now;
+  }
+  C.txlen -= (int) count;
+  if (C.txlen) {
+    memmove(C.tx, C.tx + count, C.txlen);
+  }
+}
+
+void Broker::tx_file(Connection & C) {
+  int space = BROKER_TX_SIZE - C.txlen;
+
+  if (space) {
+    ssize_t count = ::read(C.file, C.tx + C.txlen, space);
+
+    if (count > 0) {
+      C.txlen += (int) count;
+    } else { // all sent, or an error
+      ::close(C.file);
+      C.file = -1;
+      C.closing = true;
+    }
+  }
+}
+
+void Broker::http_status(Connection & C, const char * status) {
+  char header[128];
+  snprintf(header, 128, "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+  tx_put(C, header, strlen(header)); // if there's no room, the connection just closes
+  C.closing = true;
+}
+
+void Broker::http_file(Connection & C, const char * path) {
+  if (C.file >= 0) { // already serving a file; no more requests are read after the first
+    return;
+  }
+  if (strstr(path, "..")) {
+    http_status(C, "403 Forbidden");
+    return;
+  }
+  if (strcmp(path, "/") == 0) {
+    path = "/index.html";
+  }
+
+  char filename[256];
+  snprintf(filename, 256, "%s%s", m_webdir, path + 1); // m_webdir ends with '/'
+
+  C.file = open(filename, O_RDONLY);
+  if (C.file < 0) {
+    http_status(C, "404 Not Found");
+    return;
+  }
+
+  off_t size = lseek(C.file, 0, SEEK_END);
+  lseek(C.file, 0, SEEK_SET);
+
+  char header[256];
+  snprintf(header, 256, "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %ld\r\nConnection: close\r\n\r\n",
+	   s_content_type(filename), (long) size);
+
+  C.closing = true; // stop reading requests; close once the file is sent
+
+  if (!tx_put(C, header, strlen(header))) {
+    ::close(C.file);
+    C.file = -1;
+    return;
+  }
+  tx_file(C);
+}
+
+bool Broker::http_upgrade(Connection & C, const char * key, bool mqtt_protocol) {
+  static const char * guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+  char accept_key[128];
+  snprintf(accept_key, 128, "%s%s", key, guid);
+
+  unsigned char digest[20];
+  s_sha1(accept_key, digest);
+  s_base64(digest, 20, accept_key);
+
+  char header[256];
+  snprintf(header, 256, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n%s\r\n",
+	   accept_key, mqtt_protocol ? "Sec-WebSocket-Protocol: mqtt\r\n" : "");
+  if (!tx_put(C, header, strlen(header))) {
+    return false;
+  }
+
+  C.type = Connection::ct_WebSocket;
+
+  if (m_verbose)
+    fprintf(stdout, "broker: [%d] WebSocket\n", C.fd);
+  return true;
+}
+
+bool Broker::http(Connection & C) {
+  if (C.rxlen == BROKER_RX_SIZE) { // request too long
+    return false;
+  }
+  C.rx[C.rxlen] = 0;
+
+  char * request = (char *) C.rx;
+  char * end = strstr(request, "\r\n\r\n");
+  if (!end) {
+    return true; // wait for the rest
+  }
+  int request_length = (int) (end + 4 - request);
+  *end = 0;
+
+  char * path = 0;
+  const char * key = 0;
+
+  bool upgrade = false;
+  bool mqtt_protocol = false;
+
+  char * line = request;
+  while (line) {
+    char * next = strstr(line, "\r\n");
+    if (next) {
+      *next = 0;
+      next += 2;
+    }
+    if (line == request) {
+      if (strncmp(line, "GET ", 4) == 0) {
+	path = line + 4;
+	char * ptr = strchr(path, ' ');
+	if (ptr) *ptr = 0;
+	ptr = strchr(path, '?');
+	if (ptr) *ptr = 0;
+      }
+    } else if (strncasecmp(line, "Upgrade:", 8) == 0) {
+      upgrade = strcasestr(line + 8, "websocket") != 0;
+    } else if (strncasecmp(line, "Sec-WebSocket-Key:", 18) == 0) {
+      key = line + 18;
+      while (*key == ' ') ++key;
+    } else if (strncasecmp(line, "Sec-WebSocket-Protocol:", 23) == 0) {
+      mqtt_protocol = strstr(line + 23, "mqtt") != 0;
+    }
+    line = next;
+  }
+
+  if (!path) {
+    http_status(C, "405 Method Not Allowed");
+  } else if (upgrade && key) {
+    if (!http_upgrade(C, key, mqtt_protocol)) {
+      return false;
+    }
+  } else {
+    http_file(C, path);
+  }
+
+  C.rxlen -= request_length;
+  if (C.rxlen) {
+    memmove(C.rx, C.rx + request_length, C.rxlen);
+  }
+  return true;
+}
+
+void Broker::ws_frame(Connection & C, unsigned char opcode, const unsigned char * payload, int length) {
+  unsigned char header[4];
+  int hlen = 2;
+
+  header[0] = 0x80 | opcode; // FIN
+  if (length < 126) {
+    header[1] = (unsigned char) length;
+  } else {
+    header[1] = 126;
+    header[2] = (unsigned char) (length >> 8);
+    header[3] = (unsigned char) (length & 0xFF);
+    hlen = 4;
+  }
+  if (!tx_space(C, hlen + length)) {
+    ++C.dropped;
+    return;
+  }
+  tx_put(C, header, hlen);
+  tx_put(C, payload, length);
+}
+
+bool Broker::ws_unwrap(Connection & C) {
+  int pos = 0;
+
+  while (C.rxlen - pos >= 2) {
+    unsigned char * frame = C.rx + pos;
+    int available = C.rxlen - pos;
+
+    unsigned char opcode = frame[0] & 0x0F;
+    bool masked = frame[1] & 0x80;
+    unsigned long length = frame[1] & 0x7F;
+    int hlen = 2;
+
+    if (length == 126) {
+      if (available < 4) break;
+      length = ((unsigned long) frame[2] << 8) | frame[3];
+      hlen = 4;
+    } else if (length == 127) {
+      if (available < 10) break;
+      if (frame[2] || frame[3] || frame[4] || frame[5] || frame[6] || frame[7]) {
+	return false; // far too long
+      }
+      length = ((unsigned long) frame[8] << 8) | frame[9];
+      hlen = 10;
+    }
+    if (!masked) {
+      return false; // client frames must be masked
+    }
+    hlen += 4;
+
+    if (length > BROKER_RX_SIZE - (unsigned long) hlen) {
+      return false;
+    }
+    if ((unsigned long) available < hlen + length) {
+      break;
+    }
+
+    unsigned char * mask = frame + hlen - 4;
+    unsigned char * payload = frame + hlen;
+
+    for (unsigned long i = 0; i < length; i++) {
+      payload[i] ^= mask[i & 3];
+    }
+
+    switch (opcode) {
+    case 0x0: // continuation
+    case 0x1: // text
+    case 0x2: // binary
+      if (C.mqlen + (int) length > BROKER_RX_SIZE) {
+	return false;
+      }
+      memcpy(C.mq + C.mqlen, payload, length);
+      C.mqlen += (int) length;
+      break;
+    case 0x8: // close
+      ws_frame(C, 0x8, payload, (length > 2) ? 2 : (int) length);
+      C.closing = true;
+      break;
+    case 0x9: // ping
+      ws_frame(C, 0xA, payload, (int) length);
+      break;
+    default:  // pong, etc.
+      break;
+    }
+    pos += hlen + (int) length;
+  }
+
+  C.rxlen -= pos;
+  if (C.rxlen) {
+    memmove(C.rx, C.rx + pos, C.rxlen);
+  }
+  return mqtt_process(C, C.mq, C.mqlen);
+}
+
+bool Broker::mqtt_send(Connection & C, unsigned char header, const unsigned char * a, int alength, const unsigned char * b, int blength) {
+  unsigned char packet[BROKER_RX_SIZE];
+
+  int remaining = alength + blength;
+  int length = 0;
+
+  packet[length++] = header;
+  do {
+    unsigned char byte = remaining & 0x7F;
+    remaining >>= 7;
+    packet[length++] = remaining ? (byte | 0x80) : byte;
+  } while (remaining);
+
+  if (length + alength + blength > BROKER_RX_SIZE) {
+    ++C.dropped;
+    return false;
+  }
+  memcpy(packet + length, a, alength);
+  length += alength;
+  if (blength) {
+    memcpy(packet + length, b, blength);
+    length += blength;
+  }
+
+  if (C.type == Connection::ct_WebSocket) {
+    int before = C.txlen;
+    ws_frame(C, 0x2, packet, length);
+    return C.txlen != before;
+  }
+  if (!tx_space(C, length)) {
+    ++C.dropped;
+    return false;
+  }
+  tx_put(C, packet, length);
+  return true;
+}
+
+bool Broker::mqtt_process(Connection & C, unsigned char * buffer, int & length) {
+  int pos = 0;
+
+  while (length - pos >= 2) {
+    unsigned char * packet = buffer + pos;
+    int available = length - pos;
+
+    unsigned long remaining = 0;
+    int multiplier = 1;
+    int i = 1;
+    bool complete = false;
+
+    while (i < available && i <= 4) {
+      unsigned char byte = packet[i++];
+      remaining += (byte & 0x7F) * multiplier;
+      multiplier *= 128;
+      if (!(byte & 0x80)) {
+	complete = true;
+	break;
+      }
+    }
+    if (!complete) {
+      if (i > 4) {
+	return false; // malformed remaining length
+      }
+      break;
+    }
+    if (i + remaining > BROKER_RX_SIZE) {
+      return false; // too big
+    }
+    if ((unsigned long) available < i + remaining) {
+      break;
+    }
+    if (!mqtt_packet(C, packet[0] >> 4, packet[0] & 0x0F, packet + i, (int) remaining)) {
+      return false;
+    }
+    pos += i + (int) remaining;
+  }
+
+  length -= pos;
+  if (length) {
+    memmove(buffer, buffer + pos, length);
+  }
+  return true;
+}
+
+bool Broker::mqtt_packet(Connection & C, unsigned char type, unsigned char flags, const unsigned char * body, int length) {
+  if (!C.connected && type != 1) {
+    return false; // first packet must be CONNECT
+  }
+
+  switch (type) {
+  case 1: // CONNECT
+    {
+      if (C.connected || length < 10) {
+	return false;
+      }
+      int name_length = (body[0] << 8) | body[1];
+      if (length < name_length + 6) {
+	return false;
+      }
+      const unsigned char * ptr = body + 2 + name_length + 2; // skip protocol level & connect flags
+      C.keepalive_ms = 1000UL * (unsigned long) ((ptr[0] << 8) | ptr[1]);
+      C.connected = true;
+
+      const unsigned char connack[2] = { 0x00, 0x00 }; // no session present; accepted
+      mqtt_send(C, 0x20, connack, 2);
+
+      if (m_verbose)
+	fprintf(stdout, "broker: [%d] MQTT connect (keep-alive %lus)\n", C.fd, C.keepalive_ms / 1000);
+      break;
+    }
+  case 3: // PUBLISH
+    {
+      int qos = (flags >> 1) & 3;
+      if (length < 2) {
+	return false;
+      }
+      int topic_length = (body[0] << 8) | body[1];
+      int pos = 2 + topic_length;
+      if (qos) {
+	pos += 2;
+      }
+      if (pos > length) {
+	return false;
+      }
+      if (qos) {
+	const unsigned char * id = body + pos - 2;
+	mqtt_send(C, (qos == 1) ? 0x40 : 0x50, id, 2); // PUBACK or PUBREC
+      }
+      if (topic_length < BROKER_TOPIC_MAX) {
+	char topic[BROKER_TOPIC_MAX];
+	memcpy(topic, body + 2, topic_length);
+	topic[topic_length] = 0;
+
+	route(topic, (const char *) body + pos, length - pos, &C);
+      }
+      break;
+    }
+  case 6: // PUBREL
+    {
+      if (length < 2) {
+	return false;
+      }
+      mqtt_send(C, 0x70, body, 2); // PUBCOMP
+      break;
+    }
+  case 8: // SUBSCRIBE
+    {
+      if (length < 2) {
+	return false;
+      }
+      unsigned char suback[2 + BROKER_RX_SIZE / 3]; // a return code for every filter, each at least 3 bytes
+      int count = 0;
+
+      suback[0] = body[0]; // packet ID
+      suback[1] = body[1];
+
+      int pos = 2;
+      while (pos + 2 < length) { // the subscription table refuses any beyond BROKER_SUBS_MAX
+	int filter_length = (body[pos] << 8) | body[pos+1];
+	pos += 2;
+	if (pos + filter_length + 1 > length) {
+	  return false;
+	}
+	bool granted = false;
+	if (filter_length < BROKER_TOPIC_MAX) {
+	  char filter[BROKER_TOPIC_MAX];
+	  memcpy(filter, body + pos, filter_length);
+	  filter[filter_length] = 0;
+
+	  for (int s = 0; s < C.sub_count; s++) {
+	    if (strcmp(C.subs[s], filter) == 0) {
+	      granted = true;
+	      break;
+	    }
+	  }
+	  if (!granted && C.sub_count < BROKER_SUBS_MAX) {
+	    strcpy(C.subs[C.sub_count++], filter);
+	    granted = true;
+	  }
+	  if (m_verbose)
+	    fprintf(stdout, "broker: [%d] subscribe %s%s\n", C.fd, filter, granted ? "" : " - refused");
+	}
+	suback[2 + count++] = granted ? 0x00 : 0x80; // QoS 0, or failure
+	pos += filter_length + 1;
+      }
+      mqtt_send(C, 0x90, suback, 2 + count);
+      break;
+    }
+  case 10: // UNSUBSCRIBE
+    {
+      if (length < 2) {
+	return false;
+      }
+      int pos = 2;
+      while (pos + 2 <= length) {
+	int filter_length = (body[pos] << 8) | body[pos+1];
+	pos += 2;
+	if (pos + filter_length > length) {
+	  return false;
+	}
+	for (int s = 0; s < C.sub_count; s++) {
+	  if ((int) strlen(C.subs[s]) == filter_length && memcmp(C.subs[s], body + pos, filter_length) == 0) {
+	    if (s < --C.sub_count) {
+	      strcpy(C.subs[s], C.subs[C.sub_count]);
+	    }
+	    break;
+	  }
+	}
+	pos += filter_length;
+      }
+      mqtt_send(C, 0xB0, body, 2); // UNSUBACK
+      break;
+    }
+  case 12: // PINGREQ
+    {
+      mqtt_send(C, 0xD0, 0, 0); // PINGRESP
+      break;
+    }
+  case 14: // DISCONNECT
+    {
+      C.closing = true;
+      break;
+    }
+  default:
+    break;
+  }
+  return true;
+}
+
+void Broker::route(const char * topic, const char * message, int length, Connection * from) {
+  unsigned char topic_field[2 + BROKER_TOPIC_MAX];
+  int topic_length = strlen(topic);
+
+  topic_field[0] = (unsigned char) (topic_length >> 8);
+  topic_field[1] = (unsigned char) (topic_length & 0xFF);
+  memcpy(topic_field + 2, topic, topic_length);
+
+  for (int c = 0; c < BROKER_CONNECTIONS_MAX; c++) {
+    Connection & C = m_conn[c];
+
+    if (C.type == Connection::ct_Free || !C.connected || C.closing) {
+      continue;
+    }
+    for (int s = 0; s < C.sub_count; s++) {
+      if (s_topic_match(C.subs[s], topic)) {
+	mqtt_send(C, 0x30, topic_field, 2 + topic_length, (const unsigned char *) message, length);
+	break;
+      }
+    }
+  }
+
+  if (from && m_local && s_topic_match(m_local_pattern, topic)) {
+    char buffer[BROKER_RX_SIZE + 1];
+    memcpy(buffer, message, length);
+    buffer[length] = 0;
+
+    m_local->broker_message(topic, buffer, length);
+  }
+}
+
+bool Broker::subscribe(Local * L, const char * pattern) {
+  if (m_local && m_local != L) {
+    return false;
+  }
+  m_local = L;
+  m_local_pattern = pattern;
+  return true;
+}
+
+void Broker::publish(const char * topic, const void * message, int length) {
+  if (strlen(topic) < BROKER_TOPIC_MAX && length <= BROKER_RX_SIZE) {
+    route(topic, (const char *) message, length, 0);
+  }
+}
+
+void Broker::poll(unsigned long ms) {
+  m_now = ms;
+
+  fd_set read_set;
+  FD_ZERO(&read_set);
+
+  int max_fd = -1;
+
+  if (m_ws_fd >= 0) {
+    FD_SET(m_ws_fd, &read_set);
+    max_fd = m_ws_fd;
+  }
+  if (m_mqtt_fd >= 0) {
+    FD_SET(m_mqtt_fd, &read_set);
+    if (max_fd < m_mqtt_fd) max_fd = m_mqtt_fd;
+  }
+  for (int c = 0; c < BROKER_CONNECTIONS_MAX; c++) {
+    Connection & C = m_conn[c];
+
+    if (C.type == Connection::ct_Free) {
+      continue;
+    }
+    if (!C.connected && !C.closing && (m_now - C.opened > BROKER_HANDSHAKE_MS)) { // idle HTTP, or no CONNECT
+      if (m_verbose)
+	fprintf(stdout, "broker: [%d] handshake timed out\n", C.fd);
+      close(C);
+      continue;
+    }
+    if (C.keepalive_ms && (m_now - C.last_rx > C.keepalive_ms + C.keepalive_ms / 2)) {
+      if (m_verbose)
+	fprintf(stdout, "broker: [%d] keep-alive expired\n", C.fd);
+      close(C);
+      continue;
+    }
+    if (C.file >= 0) {
+      tx_file(C);
+    }
+    if (C.closing && (m_now - C.last_tx > BROKER_LINGER_MS)) {
+      if (m_verbose)
+	fprintf(stdout, "broker: [%d] %s\n", C.fd, C.shut ? "not closed by client" : "output stalled");
+      close(C);
+      continue;
+    }
+    if (C.closing && !C.txlen && C.file < 0 && !C.shut) {
+      shutdown(C.fd, SHUT_WR); // the client closes its end once it has everything
+      C.shut = true;
+      C.last_tx = m_now;
+    }
+    if (!C.closing || C.shut) {
+      FD_SET(C.fd, &read_set);
+    }
+    if (max_fd < C.fd) max_fd = C.fd;
+  }
+  if (max_fd < 0) {
+    return;
+  }
+
+  struct timeval timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 0;
+
+  if (select(max_fd + 1, &read_set, 0, 0, &timeout) < 0) {
+    return;
+  }
+
+  if (m_ws_fd >= 0 && FD_ISSET(m_ws_fd, &read_set)) {
+    accept_on(m_ws_fd, Connection::ct_HTTP);
+  }
+  if (m_mqtt_fd >= 0 && FD_ISSET(m_mqtt_fd, &read_set)) {
+    accept_on(m_mqtt_fd, Connection::ct_MQTT);
+  }
+
+  for (int c = 0; c < BROKER_CONNECTIONS_MAX; c++) {
+    Connection & C = m_conn[c];
+
+    if (C.type == Connection::ct_Free) {
+      continue;
+    }
+    if (C.closing && FD_ISSET(C.fd, &read_set)) {
+      /* Output sent & shut down: anything more is read and discarded, not parsed, until the client closes
+       * its end; closing with unread input would reset the connection and lose the response
+       */
+      ssize_t count = recv(C.fd, C.rx, BROKER_RX_SIZE, 0);
+
+      if ((count == 0 && C.shut) || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+	close(C);
+	continue;
+      }
+    } else if (FD_ISSET(C.fd, &read_set)) {
+      ssize_t count = recv(C.fd, C.rx + C.rxlen, BROKER_RX_SIZE - C.rxlen, 0);
+
+      if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+	close(C);
+	continue;
+      }
+      if (count > 0) {
+	C.rxlen += (int) count;
+	C.last_rx = m_now;
+
+	bool okay = true;
+
+	if (C.type == Connection::ct_HTTP) {
+	  okay = http(C);
+	  if (okay && C.type == Connection::ct_WebSocket && C.rxlen) {
+	    okay = ws_unwrap(C);
+	  }
+	} else if (C.type == Connection::ct_WebSocket) {
+	  okay = ws_unwrap(C);
+	} else {
+	  okay = mqtt_process(C, C.rx, C.rxlen);
+	}
+	if (!okay) {
+	  if (m_verbose)
+	    fprintf(stdout, "broker: [%d] protocol error\n", C.fd);
+	  close(C);
+	  continue;
+	}
+      }
+    }
+    if (C.txlen) { // non-blocking; also sends any responses queued above
+      tx_flush(C);
+    }
+  }
+}
@@ -0,0 +1,136 @@
+/* Copyright (c) 2019 Francis James Franklin
+ * 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ * that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ *    the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *    the following disclaimer in the documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef Car_Broker_hh
+#define Car_Broker_hh
+
+#define BROKER_CONNECTIONS_MAX  8     // simultaneous HTTP, WebSocket & MQTT connections
+#define BROKER_SUBS_MAX         8     // subscriptions per connection
+#define BROKER_TOPIC_MAX       64
+#define BROKER_RX_SIZE       4096     // also the maximum MQTT packet size
+#define BROKER_TX_SIZE      16384     // per-connection output; messages that don't fit are dropped
+#define BROKER_HANDSHAKE_MS 10000     // for the HTTP request, or upgrade, and MQTT CONNECT, from the connection opening
+#define BROKER_LINGER_MS     5000     // a closing connection is dropped if its output stalls, or the client doesn't close, for this long
+
+/* Broker is a minimal MQTT 3.1.1 broker for the topics cariot uses, with a WebSocket listener (which also
+ * serves the dashboard's static files over HTTP) and, optionally, a plain MQTT listener. It is polled from
+ * the main loop and delivers messages to a single in-process subscriber, the Local, without a network hop.
+ * QoS 1 & 2 publishes are acknowledged but all delivery is QoS 0; there are no retained messages or wills.
+ */
+class Broker {
+public:
+  class Local {
+  public:
+    /* topic and message are NUL-terminated, and valid only for the duration of the call
+     */
+    virtual void broker_message(const char * topic, const char * message, int length) = 0;
+
+    virtual ~Local();
+  };
+
+private:
+  struct Connection {
+    enum Type {
+      ct_Free = 0,
+      ct_HTTP,      // waiting for a request; becomes ct_WebSocket on upgrade
+      ct_WebSocket,
+      ct_MQTT
+    } type;
+
+    int fd;
+    int file;       // static file being served, if not -1
+
+    bool closing;   // close once the output is flushed; input is no longer parsed
+    bool shut;      // output flushed & shut down; waiting for the client to close
+    bool connected; // MQTT CONNECT received
+
+    unsigned long opened;
+    unsigned long keepalive_ms;
+    unsigned long last_rx;
+    unsigned long last_tx; // last time any output was sent
+    unsigned long dropped;
+
+    int sub_count;
+    char subs[BROKER_SUBS_MAX][BROKER_TOPIC_MAX];
+
+    int rxlen;
+    int mqlen;
+    int txlen;
+
+    unsigned char rx[BROKER_RX_SIZE]; // bytes from the socket
+    unsigned char mq[BROKER_RX_SIZE]; // MQTT stream, unwrapped from WebSocket frames
+    unsigned char tx[BROKER_TX_SIZE];
+  } m_conn[BROKER_CONNECTIONS_MAX];
+
+  Local * m_local;
+
+  const char * m_webdir;
+  const char * m_local_pattern;
+
+  int m_ws_fd;
+  int m_mqtt_fd;
+
+  unsigned long m_now;
+
+  bool m_verbose;
+
+  int listen_on(int port);
+  void accept_on(int fd, Connection::Type type);
+  void close(Connection & C);
+
+  bool tx_space(Connection & C, int length);
+  bool tx_put(Connection & C, const void * bytes, int length); // false, and nothing written, if it won't fit
+  void tx_flush(Connection & C);
+  void tx_file(Connection & C);
+
+  bool http(Connection & C);
+  bool http_upgrade(Connection & C, const char * key, bool mqtt_protocol);
+  void http_file(Connection & C, const char * path);
+  void http_status(Connection & C, const char * status);
+
+  bool ws_unwrap(Connection & C);
+  void ws_frame(Connection & C, unsigned char opcode, const unsigned char * payload, int length);
+
+  bool mqtt_process(Connection & C, unsigned char * buffer, int & length);
+  bool mqtt_packet(Connection & C, unsigned char type, unsigned char flags, const unsigned char * body, int length);
+  bool mqtt_send(Connection & C, unsigned char header, const unsigned char * a, int alength, const unsigned char * b = 0, int blength = 0);
+
+  void route(const char * topic, const char * message, int length, Connection * from);
+
+public:
+  /* ws_port is required; mqtt_port may be zero for no plain MQTT listener
+   */
+  Broker(const char * webdir, int ws_port, int mqtt_port, bool verbose);
+
+  ~Broker();
+
+  inline bool listening() const { return m_ws_fd >= 0; }
+
+  bool subscribe(Local * L, const char * pattern); // only one Local, with one pattern
+  void publish(const char * topic, const void * message, int length); // from the Local
+
+  void poll(unsigned long ms); // non-blocking; call from the main loop
+};
+
+#endif /* ! Car_Broker_hh */
@@ -39,6 +39,14 @@ static void s_init() {
 }
 
 Client::Client(const char * client_id, bool verbose) :
+  m_B(0),
+  m_queue_head(0),
+  m_queue_count(0),
+  m_policy_count(0),
+  m_inflight(0),
+  m_dropped(0),
+  m_superseded(0),
+  m_dropped_reported(0),
   m_cs(cs_NoConnection),
   m_broker("127.0.0.1"),
   m_port(1883),
@@ -46,6 +54,7 @@ Client::Client(const char * client_id, bool verbose) :
   m_keepalive(60),
   m_qos(0),
   m_retain(false),
+  m_bDraining(false),
   m_verbose(verbose)
 {
   s_init();
@@ -64,7 +73,9 @@ void Client::s_on_connect(struct mosquitto * M, void * user_data, int rc) {
     if (C->verbose())
       fprintf(stdout, "client: connect: success\n");
     C->m_cs = cs_Connected;
+    C->m_inflight = 0;
     C->setup();
+    C->drain(); // replay anything queued while disconnected
   } else {
     if (C->verbose())
       fprintf(stdout, "client: connect: failed (%d)\n", rc);
@@ -73,10 +84,21 @@ void Client::s_on_connect(struct mosquitto * M, void * user_data, int rc) {
 }
 
 bool Client::connect() {
+  if (m_B) { // embedded broker: always connected
+    if (m_cs != cs_Connected) {
+      m_cs = cs_Connected;
+      m_inflight = 0;
+      setup();
+      drain();
+    }
+    return true;
+  }
+
   mosquitto_connect_callback_set(m_M, Client::s_on_connect);
   mosquitto_disconnect_callback_set(m_M, Client::s_on_disconnect);
   mosquitto_subscribe_callback_set(m_M, Client::s_on_subscribe);
   mosquitto_message_callback_set(m_M, Client::s_on_message);
+  mosquitto_publish_callback_set(m_M, Client::s_on_publish);
 
   if (m_cs != cs_NoConnection) {
     return false;
@@ -102,9 +124,14 @@ void Client::s_on_disconnect(struct mosquitto * M, void * user_data, int rc) {
   if (C->verbose())
     fprintf(stdout, "client: disconnected (%d)\n", rc);
   C->m_cs = cs_NoConnection;
+  C->m_inflight = 0;
 }
 
 void Client::disconnect() {
+  if (m_B) {
+    m_cs = cs_NoConnection;
+    return;
+  }
   m_cs = cs_Disconnecting;
   mosquitto_disconnect(m_M);
 }
@@ -113,25 +140,123 @@ void Client::s_on_publish(struct mosquitto * M, void * user_data, int mid) {
   Client * C = reinterpret_cast<Client *>(user_data);
   if (C->verbose())
     fprintf(stdout, "client: %d published\n", mid);
+  if (C->m_inflight > 0) {
+    --C->m_inflight;
+  }
+  C->drain(); // does nothing if called from within drain()
+}
+
+bool Client::queue_policy(const char * topic, QueuePolicy policy) {
+  for (int p = 0; p < m_policy_count; p++) {
+    if (strcmp(m_policy[p].topic, topic) == 0) {
+      m_policy[p].policy = policy;
+      return true;
+    }
+  }
+  if (m_policy_count == CLIENT_POLICIES_MAX || strlen(topic) >= CLIENT_TOPIC_MAX) {
+    return false;
+  }
+  strcpy(m_policy[m_policy_count].topic, topic);
+  m_policy[m_policy_count++].policy = policy;
+  return true;
+}
+
+Client::QueuePolicy Client::policy(const char * topic) const {
+  for (int p = 0; p < m_policy_count; p++) {
+    if (strcmp(m_policy[p].topic, topic) == 0) {
+      return m_policy[p].policy;
+    }
+  }
+  return qp_DropOldest;
 }
 
 bool Client::publish(const char * topic, const char * message) {
-  mosquitto_publish_callback_set(m_M, Client::s_on_publish);
+  return publish(topic, message, strlen(message));
+}
 
-  m_mid = 0;
-  if (mosquitto_publish(m_M, &m_mid, topic, strlen(message), message, m_qos, m_retain) == MOSQ_ERR_SUCCESS) {
+bool Client::publish(const char * topic, const void * payload, int length) {
+  if (length > CLIENT_PAYLOAD_MAX || strlen(topic) >= CLIENT_TOPIC_MAX) {
     if (verbose())
-      fprintf(stdout, "client: %d publishing...\n", m_mid);
-    return true;
-  } else {
+      fprintf(stdout, "client: message on topic %s too big to queue\n", topic);
+    ++m_dropped;
     return false;
   }
+
+  Message * M = 0;
+
+  if (policy(topic) == qp_Latest) { // replace the pending value, if any
+    for (int q = 0; q < m_queue_count; q++) {
+      Message & P = m_queue[(m_queue_head + q) % CLIENT_QUEUE_SIZE];
+      if (strcmp(P.topic, topic) == 0) {
+	M = &P;
+	++m_superseded;
+	break;
+      }
+    }
+  }
+  if (!M) {
+    if (m_queue_count == CLIENT_QUEUE_SIZE) { // drop the oldest
+      m_queue_head = (m_queue_head + 1) % CLIENT_QUEUE_SIZE;
+      --m_queue_count;
+      ++m_dropped;
+    }
+    M = &m_queue[(m_queue_head + m_queue_count++) % CLIENT_QUEUE_SIZE];
+    strcpy(M->topic, topic);
+  }
+  memcpy(M->payload, payload, length);
+  M->length = length;
+
+  drain();
+  return true;
+}
+
+void Client::drain() {
+  if (m_bDraining) { // called again from a callback, e.g., on_publish inside mosquitto_publish() at QoS 0
+    return;
+  }
+  m_bDraining = true;
+
+  while (connected() && m_queue_count && (m_inflight < CLIENT_INFLIGHT_MAX)) {
+    int head = m_queue_head;
+    Message M = m_queue[head]; // a copy, since the slot is free to be reused once dequeued
+
+    /* Dequeue before publishing: libmosquitto may call on_publish before mosquitto_publish() returns, and an
+     * embedded broker may deliver to a local subscriber that publishes in turn
+     */
+    m_queue_head = (m_queue_head + 1) % CLIENT_QUEUE_SIZE;
+    --m_queue_count;
+
+    if (m_B) { // delivered immediately
+      m_B->publish(M.topic, M.payload, M.length);
+      continue;
+    }
+
+    ++m_inflight;
+
+    m_mid = 0;
+    if (mosquitto_publish(m_M, &m_mid, M.topic, M.length, M.payload, m_qos, m_retain) != MOSQ_ERR_SUCCESS) {
+      --m_inflight; // leave it queued; try again later
+      m_queue_head = head;
+      ++m_queue_count;
+      break;
+    }
+    if (verbose())
+      fprintf(stdout, "client: %d publishing...\n", m_mid);
+  }
+
+  m_bDraining = false;
 }
 
 void Client::message(const char * topic, const char * message, int length) {
   // ...
 }
 
+void Client::broker_message(const char * topic, const char * message, int length) {
+  if (verbose())
+    fprintf(stdout, "client: message received on topic %s\n", topic);
+  this->message(topic, message, length);
+}
+
 void Client::s_on_message(struct mosquitto * M, void * user_data, const struct mosquitto_message * message) {
   Client * C = reinterpret_cast<Client *>(user_data);
   if (C->verbose())
@@ -146,6 +271,10 @@ void Client::s_on_subscribe(struct mosquitto * M, void * user_data, int mid, int
 }
 
 bool Client::subscribe(const char * pattern) {
+  if (m_B) {
+    return m_B->subscribe(this, pattern);
+  }
+
   bool success = true;
 
   m_mid = 0;
@@ -165,12 +294,22 @@ void Client::setup() {
 }
 
 void Client::tick() {
-  mosquitto_loop(m_M, 0, 1);
+  drain();
+  if (m_B) {
+    m_B->poll(millis());
+  } else {
+    mosquitto_loop(m_M, 0, 1);
+  }
 
   Ticker::tick();
 }
 
 void Client::second() {
+  if (verbose() && (m_dropped != m_dropped_reported)) {
+    fprintf(stdout, "client: queue: depth %d, in flight %d; %lu dropped, %lu superseded\n",
+	    m_queue_count, m_inflight, m_dropped, m_superseded);
+    m_dropped_reported = m_dropped;
+  }
   if (!connected()) {
     if (!connecting()) {
       connect();
@@ -25,13 +25,52 @@
 #define Car_Client_hh
 
 #include "Ticker.hh"
+#include "Broker.hh"
+
+#define CLIENT_QUEUE_SIZE    32 // outbound messages held while disconnected or while the broker is slow
+#define CLIENT_INFLIGHT_MAX   8 // messages handed to libmosquitto but not yet sent
+#define CLIENT_TOPIC_MAX     64
+#define CLIENT_PAYLOAD_MAX   64
+#define CLIENT_POLICIES_MAX   8
 
 struct mosquitto;
 
-class Client : public Ticker {
+class Client : public Ticker, public Broker::Local {
+public:
+  enum QueuePolicy {
+    qp_DropOldest = 0, // queue every message; when the queue is full, the oldest message is dropped
+    qp_Latest          // state topics: only the latest value is kept while waiting to be sent
+  };
+
 private:
   struct mosquitto * m_M;
 
+  Broker * m_B; // embedded broker, if any; used instead of libmosquitto
+
+  struct Message {
+    char topic[CLIENT_TOPIC_MAX];
+    unsigned char payload[CLIENT_PAYLOAD_MAX];
+    int length;
+  } m_queue[CLIENT_QUEUE_SIZE];
+
+  struct Policy {
+    char topic[CLIENT_TOPIC_MAX];
+    QueuePolicy policy;
+  } m_policy[CLIENT_POLICIES_MAX];
+
+  int m_queue_head;
+  int m_queue_count;
+  int m_policy_count;
+  int m_inflight;
+
+  unsigned long m_dropped;    // messages lost to a full queue, or too big to queue
+  unsigned long m_superseded; // state messages replaced by a later value before being sent
+  unsigned long m_dropped_reported;
+
+  QueuePolicy policy(const char * topic) const;
+
+  void drain(); // hand queued messages to libmosquitto, as far as backpressure allows
+
   enum ConnectionStatus {
     cs_NoConnection = 0,
     cs_Disconnecting,
@@ -51,6 +90,7 @@ protected:
 
   bool m_retain;
 private:
+  bool m_bDraining; // drain() in progress
   bool m_verbose;
 
 public:
@@ -62,6 +102,12 @@ public:
     return m_verbose;
   }
 
+  /* Use an embedded broker instead of connecting to one; call before the loop starts
+   */
+  inline void use_broker(Broker * B) {
+    m_B = B;
+  }
+
 private:
   static void s_on_connect(struct mosquitto * M, void * user_data, int rc);
 public:
@@ -82,9 +128,22 @@ public:
 private:
   static void s_on_publish(struct mosquitto * M, void * user_data, int mid);
 public:
+  /* Messages are queued and sent as soon as the connection and broker allow; returns false only if the
+   * message was rejected outright (i.e., too big)
+   */
   bool publish(const char * topic, const char * message);
+  bool publish(const char * topic, const void * payload, int length); // binary payload
+
+  bool queue_policy(const char * topic, QueuePolicy policy); // returns false if the policy table is full
+
+  inline int queue_depth() const { return m_queue_count; }
+  inline int queue_inflight() const { return m_inflight; }
+  inline unsigned long queue_dropped() const { return m_dropped; }
+  inline unsigned long queue_superseded() const { return m_superseded; }
 
   virtual void message(const char * topic, const char * message, int length);
+
+  virtual void broker_message(const char * topic, const char * message, int length);
 private:
   static void s_on_message(struct mosquitto * M, void * user_data, const struct mosquitto_message * message);
 
@@ -35,37 +35,104 @@
 
 #include "Serial.hh"
 
+Serial::Reader::~Reader() {
+  // ...
+}
+
 Serial::Command::~Command() {
   // ...
 }
 
+void Serial::Command::serial_text(const char * str, int length) {
+  // ...
+}
+
+void Serial::Command::serial_read(const char * bytes, int length) {
+  const char * end = bytes + length;
+
+  while (bytes < end) {
+    if (m_text) { // inside a text frame; hand over as much of it as we have, in place
+      int count = end - bytes;
+      if (count > m_text) {
+	count = m_text;
+      }
+      m_text -= count;
+      serial_text(bytes, count);
+      bytes += count;
+      continue;
+    }
+    char byte = *bytes++;
+
+    if ((byte >= 'A' && byte <= 'Z') || (byte >= 'a' && byte <= 'z') || (byte == '$')) {
+      m_buffer[0] = byte;
+      m_length = 1;
+    } else if (byte >= '0' && byte <= '9') {
+      if (m_length > 0 && m_length < 11) {
+	m_buffer[m_length++] = byte;
+      } else {
+	m_length = 0;
+      }
+    } else if (byte == ',') {
+      if (m_length && (m_buffer[0] == '$')) { // text frame header
+	m_buffer[m_length] = 0;
+	unsigned long count = strtoul(m_buffer+1, 0, 10);
+	if (!count) {
+	  serial_text(0, 0); // end of string
+	} else if (count <= SERIAL_TEXT_MAX) {
+	  m_text = (int) count;
+	}
+      } else if (m_length > 1) {
+	m_buffer[m_length] = 0;
+	serial_command(m_buffer[0], strtoul(m_buffer+1, 0, 10));
+      } else if (m_length == 1) {
+	serial_command(m_buffer[0], 0);
+      }
+      m_length = 0;
+    } else {
+      m_length = 0;
+    }
+  }
+  if (!length) { // end of stream
+    m_length = 0;
+    m_text = 0;
+  }
+}
+
 Serial::Report::~Report() {
   // ...
 }
 
-Serial::Serial(Serial::Command * C, const char * device_name, bool bFixBaud, bool verbose) :
-  m_C(C),
-  m_R(0),
-  m_device(device_name),
-  m_fd(-1),
-  m_length(0),
-  m_replen(0),
-  m_bFixBAUD(bFixBaud),
-  m_verbose(verbose)
-{
-  connect();
+void Serial::Report::serial_read(const char * bytes, int length) {
+  const char * end = bytes + length;
+
+  while (bytes < end) {
+    char byte = *bytes++;
+
+    if (byte) {
+      m_report[m_replen++] = byte;
+      if (m_replen == 255 || byte == '\n') {
+	m_report[m_replen] = 0;
+	serial_report(m_report);
+	m_replen = 0;
+      }
+    }
+  }
+  if (!length && m_replen) { // end of stream; flush the incomplete report
+    m_report[m_replen] = 0;
+    serial_report(m_report);
+    m_replen = 0;
+  }
 }
 
-Serial::Serial(Serial::Report * R, const char * device_name, bool bFixBaud, bool verbose) :
-  m_C(0),
-  m_R(R),
+Serial::Serial(Serial::Reader * R, const char * device_name, bool bFixBaud, bool verbose) :
   m_device(device_name),
+  m_reader_count(0),
+  m_txlen(0),
   m_fd(-1),
-  m_length(0),
-  m_replen(0),
   m_bFixBAUD(bFixBaud),
   m_verbose(verbose)
 {
+  add_reader(R);
   connect();
 }
 
@@ -73,12 +140,35 @@ Serial::~Serial() {
   disconnect();
 }
 
+bool Serial::add_reader(Serial::Reader * R) {
+  if (!R) {
+    return true;
+  }
+  if (m_reader_count == SERIAL_READERS_MAX) {
+    if (m_verbose)
+      fprintf(stderr, "Serial: Too many readers.\n");
+    return false;
+  }
+  m_readers[m_reader_count++] = R;
+
+  if (connected()) { // late arrival
+    R->serial_connect();
+  }
+  return true;
+}
+
 void Serial::sleep() {
   if (m_fd < 0) {
     usleep(1);
     return;
   }
 
+  flush(); // merged output from all producers since the last pass
+
+  if (m_fd < 0) { // flush() failed
+    return;
+  }
+
   fd_set set;
   FD_ZERO(&set);
   FD_SET(m_fd, &set);
@@ -100,11 +190,10 @@ void Serial::sleep() {
     return;
   }
 
-  unsigned char byte;
   bool bFirst = true;
 
   while (true) {
-    int count = ::read(m_fd, &byte, 1);
+    ssize_t count = ::read(m_fd, m_rx, SERIAL_RX_SIZE);
     if (bFirst) {
       if (!count) { // if we got this far, there really should be some input - unless...
 	if (m_verbose)
@@ -127,51 +216,55 @@ void Serial::sleep() {
       break;
     }
 
-    if (m_R) {
-      if (byte) {
-	m_report[m_replen++] = byte;
-	if (m_replen == 255 || byte == '\n') {
-	  m_report[m_replen] = 0;
-	  m_R->serial_report(m_report);
-	  m_replen = 0;
-	}
-      }
-      continue;
+    for (int r = 0; r < m_reader_count; r++) {
+      m_readers[r]->serial_read(m_rx, (int) count);
     }
-
-    if ((byte >= 'A' && byte <= 'Z') || (byte >= 'a' && byte <= 'z')) {
-      m_buffer[0] = byte;
-      m_length = 1;
-    } else if (byte >= '0' && byte <= '9') {
-      if (m_length > 0 && m_length < 11) {
-	m_buffer[m_length++] = byte;
-      } else {
-	m_length = 0;
-      }
-    } else if (byte == ',') {
-      if (m_length > 1) {
-	m_buffer[m_length] = 0;
-	if (m_C) {
-	  m_C->serial_command(m_buffer[0], strtoul(m_buffer+1, 0, 10));
-	}
-      } else if (m_length == 1) {
-	if (m_C) {
-	  m_C->serial_command(m_buffer[0], 0);
-	}
-      }
-      m_length = 0;
-    } else {
-      m_length = 0;
+    if (count < SERIAL_RX_SIZE) { // device drained
+      break;
     }
   }
 }
 
-void Serial::write(char command, unsigned long value) {
-  static char buffer[16];
+void Serial::flush() {
+  if (m_fd < 0 || !m_txlen) {
+    return;
+  }
 
+  ssize_t result = ::write(m_fd, m_tx, m_txlen);
+
+  if (result == -1) {
+    if (m_verbose)
+      fprintf(stderr, "Serial: Failed to write to device\n");
+    disconnect();
+  } else if (result < m_txlen) {
+    if (m_verbose)
+      fprintf(stderr, "Serial: Incomplete write to device: %d bytes of %d written.\n", (int) result, m_txlen);
+    disconnect();
+  }
+  m_txlen = 0;
+}
+
+void Serial::write(const char * bytes, int length) {
   if (m_fd < 0) {
     return;
   }
+  if (m_txlen + length > SERIAL_TX_SIZE) {
+    flush();
+    if (m_fd < 0) {
+      return;
+    }
+    if (length > SERIAL_TX_SIZE) {
+      if (m_verbose)
+	fprintf(stderr, "Serial: Write of %d bytes exceeds output buffer - ignoring.\n", length);
+      return;
+    }
+  }
+  memcpy(m_tx + m_txlen, bytes, length);
+  m_txlen += length;
+}
+
+void Serial::write(char command, unsigned long value) {
+  char buffer[16];
 
   buffer[0] = command;
 
@@ -182,19 +275,7 @@ void Serial::write(char command, unsigned long value) {
     buffer[2] = 0;
   }
 
-  int count = strlen(buffer);
-
-  ssize_t result = ::write(m_fd, buffer, count);
-
-  if (result == -1) {
-    if (m_verbose)
-      fprintf(stderr, "Serial: Failed to write to device\n");
-    disconnect();
-  } else if (result < count) {
-    if (m_verbose)
-      fprintf(stderr, "Serial: Incomplete write to device: %d bytes of %d written.\n", (int) result, count);
-    disconnect();
-  }
+  write(buffer, strlen(buffer));
 }
 
 void Serial::connect() {
@@ -224,17 +305,13 @@ void Serial::connect() {
     tcsetattr(m_fd, TCSANOW, &options);
   }
 
-  unsigned char byte;
-
-  while (::read(m_fd, &byte, 1) > 0) {
+  while (::read(m_fd, m_rx, SERIAL_RX_SIZE) > 0) {
     // empty the input buffer
   }
+  m_txlen = 0;
 
-  if (m_C) {
-    m_C->serial_connect();
-  }
-  if (m_R) {
-    m_R->serial_connect();
+  for (int r = 0; r < m_reader_count; r++) {
+    m_readers[r]->serial_connect();
   }
 }
 
@@ -242,17 +319,11 @@ void Serial::disconnect() {
   if (m_fd >= 0) {
     close(m_fd);
     m_fd = -1;
+    m_txlen = 0;
 
-    if (m_C) {
-      m_C->serial_disconnect();
-    }
-    if (m_R) {
-      if (m_replen) {
-	m_report[m_replen] = 0;
-	m_R->serial_report(m_report);
-	m_replen = 0;
-      }
-      m_R->serial_disconnect();
+    for (int r = 0; r < m_reader_count; r++) {
+      m_readers[r]->serial_read(m_rx, 0); // end of stream
+      m_readers[r]->serial_disconnect();
     }
   }
 }
@@ -26,52 +26,90 @@
 
 #include "Ticker.hh"
 
+#define SERIAL_READERS_MAX 4    // maximum number of consumers of the incoming byte stream
+#define SERIAL_RX_SIZE     1024 // shared receive buffer; the device is read in bulk
+#define SERIAL_TX_SIZE     1024 // merged output from all producers; flushed once per loop
+#define SERIAL_TEXT_MAX    128  // maximum length of a single text frame; see COMMANDER_TEXT_MAX in the Buggy
+
+/* Serial owns the device and multiplexes it: each read from the device is handed, in place, to every
+ * registered Reader, and writes from any number of producers are merged into a single output buffer.
+ */
 class Serial : public Ticker::Sleeper {
 public:
-  // commands have format {A-Za-z}{0-9}*,
-  class Command {
+  class Reader {
   public:
     virtual void serial_connect() = 0;
     virtual void serial_disconnect() = 0;
+
+    /* bytes points into the shared receive buffer and is valid only for the duration of the call;
+     * length == 0 signals the end of the stream, i.e., the device is about to disconnect
+     */
+    virtual void serial_read(const char * bytes, int length) = 0;
+
+    virtual ~Reader();
+  };
+
+  // commands have format {A-Za-z}{0-9}*, and text arrives in frames: "$<length>,<bytes>" ... "$,"
+  class Command : public Reader {
+  private:
+    int  m_length;
+    int  m_text;       // bytes remaining in the current text frame
+    char m_buffer[16];
+  public:
+    Command() : m_length(0), m_text(0) { }
+
     virtual void serial_command(char command, unsigned long value) = 0;
+    virtual void serial_read(const char * bytes, int length);
+
+    /* Text from the Buggy's command_print(), in one or more fragments pointing into the receive buffer;
+     * a call with length 0 marks the end of the string. By default, text is discarded.
+     */
+    virtual void serial_text(const char * str, int length);
 
     virtual ~Command();
   };
 
-  class Report {
+  class Report : public Reader {
+  private:
+    int  m_replen;
+    char m_report[256];
   public:
-    virtual void serial_connect() = 0;
-    virtual void serial_disconnect() = 0;
+    Report() : m_replen(0) { }
+
     virtual void serial_report(const char * report) = 0;
+    virtual void serial_read(const char * bytes, int length);
 
     virtual ~Report();
   };
 
 private:
-  Command * m_C;
-  Report *  m_R;
+  Reader * m_readers[SERIAL_READERS_MAX];
 
   const char * m_device;
 
-  int m_length;
-  int m_replen;
+  int m_reader_count;
+  int m_txlen;
   int m_fd;
 
   bool m_bFixBAUD;
   bool m_verbose;
 
-  char m_report[256];
-  char m_buffer[16];
+  char m_rx[SERIAL_RX_SIZE];
+  char m_tx[SERIAL_TX_SIZE];
+
+  void flush();
 
 public:
   inline bool connected() const { return m_fd >= 0; }
 
-  Serial(Command * C, const char * device_name, bool bFixBaud, bool verbose);
-  Serial(Report * R, const char * device_name, bool bFixBaud, bool verbose);
+  Serial(Reader * R, const char * device_name, bool bFixBaud, bool verbose);
 
   ~Serial();
 
+  bool add_reader(Reader * R); // returns false if there are already SERIAL_READERS_MAX readers
+
   void write(char command, unsigned long value);
+  void write(const char * bytes, int length); // raw bytes; should be complete commands
 
   virtual void sleep();
 
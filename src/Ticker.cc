@@ -21,12 +21,23 @@
  * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cstdio>
+#include <cstring>
+
 #include <errno.h>
+#include <sched.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <sys/mman.h>
+
 #include "Ticker.hh"
 
+#define TICKER_STACK_PREFAULT (256*1024) // bytes of stack to touch once memory is locked
+#define TICKER_JITTER_FIRST    10000     // ms of standard scheduling before switching to real-time
+#define TICKER_JITTER_AFTER    10000     // ms until the first real-time jitter report
+#define TICKER_JITTER_PERIOD   60000     // ms between subsequent jitter reports
+
 Ticker::Sleeper::~Sleeper() {
   // ...
 }
@@ -42,21 +53,100 @@ void Ticker::get_time(unsigned long & secs, unsigned long & nano) {
   nano = (unsigned long) ts.tv_nsec;
 }
 
-unsigned long Ticker::millis () {
+void Ticker::elapsed(unsigned long & ms, unsigned long & us) {
   unsigned long new_time_secs;
   unsigned long new_time_nano;
   get_time(new_time_secs, new_time_nano);
 
-  unsigned long us = 0;
+  unsigned long ns;
 
   if (new_time_nano < m_time_nano) {
-    us  = (1000000000UL + new_time_nano - m_time_nano) / 1000000UL;
-    us += 1000UL * (new_time_secs - m_time_secs - 1);
+    ns = 1000000000UL + new_time_nano - m_time_nano;
+    ms = 1000UL * (new_time_secs - m_time_secs - 1);
+  } else {
+    ns = new_time_nano - m_time_nano;
+    ms = 1000UL * (new_time_secs - m_time_secs);
+  }
+  ms += ns / 1000000UL;
+  us  = (ns % 1000000UL) / 1000UL;
+}
+
+unsigned long Ticker::millis () {
+  unsigned long ms;
+  unsigned long us;
+  elapsed(ms, us);
+  return ms;
+}
+
+void Ticker::jitter_record(unsigned long missed, unsigned long late_us) {
+  late_us += 1000UL * missed;
+
+  ++m_jitter_count;
+  m_jitter_missed += missed;
+  m_jitter_sum += (double) late_us;
+
+  if (m_jitter_max < late_us) {
+    m_jitter_max = late_us;
+  }
+}
+
+void Ticker::jitter_report(const char * label) {
+  double mean = m_jitter_count ? (m_jitter_sum / (double) m_jitter_count) : 0;
+
+  fprintf(stdout, "ticker: jitter (%s): %lu ticks; late: mean %.1fus, max %luus; %lu ticks missed\n",
+	  label, m_jitter_count, mean, m_jitter_max, m_jitter_missed);
+  fflush(stdout);
+
+  m_jitter_count  = 0;
+  m_jitter_max    = 0;
+  m_jitter_missed = 0;
+  m_jitter_sum    = 0;
+}
+
+static void s_prefault_stack() {
+  unsigned char stack[TICKER_STACK_PREFAULT];
+
+  memset(stack, 0, sizeof(stack));
+  __asm__ __volatile__ ("" : : "r" (stack) : "memory"); // keep the memset from being optimised away
+}
+
+void Ticker::realtime_request(int cpu, int priority) {
+  m_rt = rt_Pending;
+  m_rt_cpu = cpu;
+  m_rt_priority = priority;
+  m_rt_next = millis() + TICKER_JITTER_FIRST;
+}
+
+bool Ticker::realtime() {
+  bool success = true;
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+    fprintf(stderr, "ticker: mlockall: %s - continuing without locked memory\n", strerror(errno));
+    success = false;
   } else {
-    us  = (new_time_nano - m_time_nano) / 1000000UL;
-    us += 1000UL * (new_time_secs - m_time_secs);
+    s_prefault_stack();
   }
-  return us;
+
+  if (m_rt_cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(m_rt_cpu, &set);
+
+    if (sched_setaffinity(0, sizeof(set), &set)) {
+      fprintf(stderr, "ticker: sched_setaffinity(%d): %s - continuing without CPU pinning\n", m_rt_cpu, strerror(errno));
+      success = false;
+    }
+  }
+
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = m_rt_priority;
+
+  if (sched_setscheduler(0, SCHED_FIFO, &param)) {
+    fprintf(stderr, "ticker: sched_setscheduler(SCHED_FIFO, %d): %s - continuing with standard scheduling\n", m_rt_priority, strerror(errno));
+    success = false;
+  }
+  return success;
 }
 
 void Ticker::loop() {
@@ -64,11 +154,26 @@ void Ticker::loop() {
 
   m_bLoop = true;
   while (m_bLoop) {
-    unsigned long ms1 = millis();
+    unsigned long ms1;
+    unsigned long us1;
+    elapsed(ms1, us1);
 
     if (ms0 != ms1) {
+      jitter_record(ms1 - ms0 - 1, us1);
       ms0 = ms1;
       tick();
+
+      if (m_rt && ((long) (ms1 - m_rt_next) >= 0)) {
+	if (m_rt == rt_Pending) {
+	  jitter_report("standard");
+	  m_rt = realtime() ? rt_Active : rt_Partial;
+	  m_rt_next = ms1 + TICKER_JITTER_AFTER;
+	} else {
+	  jitter_report((m_rt == rt_Active) ? "realtime" : "realtime, partial");
+	  m_rt_next = ms1 + TICKER_JITTER_PERIOD;
+	}
+	ms0 = millis(); // don't count the report as jitter
+      }
     }
     if (m_S) {
       m_S->sleep();
@@ -43,6 +43,28 @@ private:
   unsigned long m_time_nano;
 
   void get_time(unsigned long & secs, unsigned long & nano);
+  void elapsed(unsigned long & ms, unsigned long & us); // time since start; us is the sub-millisecond remainder
+
+  /* Tick jitter: how late each tick is, in microseconds, relative to its millisecond boundary
+   */
+  unsigned long m_jitter_count;
+  unsigned long m_jitter_max;
+  unsigned long m_jitter_missed;
+  double        m_jitter_sum;
+
+  void jitter_record(unsigned long missed, unsigned long late_us);
+
+  enum RealtimeStatus {
+    rt_Off = 0,
+    rt_Pending,
+    rt_Active,
+    rt_Partial  // real-time requested, but not all steps succeeded
+  } m_rt;
+
+  int m_rt_cpu;
+  int m_rt_priority;
+
+  unsigned long m_rt_next; // time [ms] of next jitter report
 
 protected:
   inline void set_sleeper(Sleeper * S) { m_S = S; }
@@ -51,7 +73,15 @@ public:
   Ticker() :
     m_S(0),
     m_bLoop(true),
-    m_ms_count(999)
+    m_ms_count(999),
+    m_jitter_count(0),
+    m_jitter_max(0),
+    m_jitter_missed(0),
+    m_jitter_sum(0),
+    m_rt(rt_Off),
+    m_rt_cpu(-1),
+    m_rt_priority(0),
+    m_rt_next(0)
   {
     get_time(m_time_secs, m_time_nano);
   }
@@ -59,6 +89,14 @@ public:
 
   unsigned long millis();
 
+  /* Request real-time scheduling: lock memory, pin to cpu (unless negative) and switch to SCHED_FIFO at
+   * the given priority. The switch happens once a baseline jitter measurement has been reported, so that
+   * the before and after jitter can be compared; further reports follow once a minute.
+   */
+  void realtime_request(int cpu, int priority);
+
+  void jitter_report(const char * label); // print & reset the tick jitter statistics
+
   inline void stop() {
     m_bLoop = false;
   }
@@ -66,6 +104,9 @@ public:
 
   virtual void tick();
   virtual void second();
+
+private:
+  bool realtime(); // returns false if any step fails, e.g., for lack of privileges
 };
 
 #endif /* ! Car_Ticker_hh */
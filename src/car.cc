@@ -32,13 +32,41 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include "Broker.hh"
 #include "Client.hh"
 #include "Serial.hh"
 
 #define CARIOT_WEBDIR "/home/pi/cariot/www/"
 
+#define CARIOT_WS_PORT   8080 // embedded broker: WebSocket & HTTP, as the http_dir listener in etc/mosquitto-cariot.conf
+#define CARIOT_MQTT_PORT 1883 // embedded broker: plain MQTT, e.g., for mosquitto_sub
+
+#define CARIOT_RT_CPU      3  // default core for --realtime; the Pi has four
+#define CARIOT_RT_PRIORITY 50 // SCHED_FIFO priority for --realtime
+
 static void loglist();
 
+/* Telemetry is published once per period on /cariot/car/state, either as text, "x y l r" with three
+ * decimal places, or (with --binary) in the compact form:
+ *   byte 0:    CARIOT_STATE_VERSION
+ *   byte 1:    n, the number of fields that follow
+ *   bytes 2..: n little-endian int16 fields, each the value x 1000: x, y, slip_l, slip_r
+ * Fields may be appended in later versions; decoders should ignore any they don't know.
+ * See mqtt_receive_state() in www/dash.js.
+ */
+#define CARIOT_STATE_VERSION 1
+#define CARIOT_STATE_FIELDS  4
+
+static unsigned char * s_pack_milli(unsigned char * ptr, float value) {
+  long milli = (long) (value * 1000 + ((value < 0) ? -0.5f : 0.5f));
+  milli = (milli < -32768) ? -32768 : ((milli > 32767) ? 32767 : milli);
+
+  unsigned short u = (unsigned short) (short) milli;
+  *ptr++ = (unsigned char) (u & 0xFF);
+  *ptr++ = (unsigned char) (u >> 8);
+  return ptr;
+}
+
 class Car : public Client, public Serial::Command {
 private:
   Serial m_S;
@@ -48,19 +76,40 @@ private:
   float slip_l;
   float slip_r;
 
+  /* Tuning parameter readback: the firmware replies to "G0," with K/U/L/H/V for each parameter,
+   * and K0 at the end; see Buggy/Buggy/Registry.hh
+   */
+  char          m_param;
+  unsigned long m_param_scale;
+  unsigned long m_param_min;
+  unsigned long m_param_max;
+
   const char * m_pattern;
 
   int m_length;
 
+  bool m_binary; // publish telemetry in binary form
+
 public:
-  Car(const char * serial, bool verbose, bool fixbaud) :
+  Car(const char * serial, bool verbose, bool fixbaud, bool binary, Serial::Reader * logger = 0) :
     Client("car", verbose),
     m_S(this, serial, fixbaud, verbose),
     x_actual(0),
-    y_actual(0)
+    y_actual(0),
+    slip_l(0),
+    slip_r(0),
+    m_param(0),
+    m_param_scale(1),
+    m_param_min(0),
+    m_param_max(0),
+    m_binary(binary)
   {
     set_sleeper(&m_S);
 
+    m_S.add_reader(logger); // share the device with the logger, if any
+
+    queue_policy("/cariot/car/state", qp_Latest); // stale telemetry is of no interest
+
     m_pattern = "/cariot/#";
     m_length = strlen(m_pattern) - 1;
   }
@@ -69,6 +118,7 @@ public:
   }
   virtual void serial_connect() {
     fprintf(stdout, "car: connected to Arduino\n");
+    m_S.write('G', 0); // request the tuning parameters
   }
   virtual void serial_disconnect() {
     fprintf(stdout, "car: disconnected from Arduino\n");
@@ -95,24 +145,61 @@ public:
 	slip_r = (-127 + (float) value) / 127;
       }
       break;
+    case 'K':
+      m_param = (char) (value & 0x7F);
+      break;
+    case 'U':
+      m_param_scale = value ? value : 1;
+      break;
+    case 'L':
+      m_param_min = value;
+      break;
+    case 'H':
+      m_param_max = value;
+      break;
+    case 'V':
+      if (m_param) {
+	float scale = (float) m_param_scale;
+	char buffer[64];
+	snprintf(buffer, 64, "%c %g %g %g", m_param, value / scale, m_param_min / scale, m_param_max / scale);
+	publish("/cariot/car/param", buffer);
+	if (verbose())
+	  fprintf(stdout, "car: parameter %s\n", buffer);
+      }
+      break;
     default:
       break;
     }
   }
   virtual void tick() { // every millisecond
     static unsigned count = 0;
-    static char buffer[32];
 
     if (++count == 100) {
       count = 0;
-      sprintf(buffer, "%.3f %.3f", x_actual, y_actual);
-      publish("/cariot/car/XY", buffer);
-      sprintf(buffer, "%.3f %.3f", slip_l, slip_r);
-      publish("/cariot/car/slip", buffer);
+      publish_state();
     }
 
     Client::tick(); // network update
   }
+  void publish_state() {
+    if (m_binary) {
+      unsigned char buffer[2 + 2 * CARIOT_STATE_FIELDS];
+      unsigned char * ptr = buffer;
+
+      *ptr++ = CARIOT_STATE_VERSION;
+      *ptr++ = CARIOT_STATE_FIELDS;
+      ptr = s_pack_milli(ptr, x_actual);
+      ptr = s_pack_milli(ptr, y_actual);
+      ptr = s_pack_milli(ptr, slip_l);
+      ptr = s_pack_milli(ptr, slip_r);
+
+      publish("/cariot/car/state", buffer, (int) (ptr - buffer));
+    } else {
+      char buffer[64];
+      snprintf(buffer, 64, "%.3f %.3f %.3f %.3f", x_actual, y_actual, slip_l, slip_r);
+      publish("/cariot/car/state", buffer);
+    }
+  }
   virtual void second() { // every second
     if (!m_S.connected()) {
       m_S.connect();
@@ -159,18 +246,15 @@ public:
   }
 };
 
-class Logger : public Ticker, public Serial::Report {
+class Logger : public Serial::Report {
 private:
-  int m_log; // must be initialised before m_S
-
-  Serial m_S;
+  int m_log;
 
 public:
-  Logger(const char * serial, bool verbose, bool fixbaud) :
-    m_log(-1),
-    m_S(this, serial, fixbaud, verbose)
+  Logger() :
+    m_log(-1)
   {
-    set_sleeper(&m_S);
+    // ...
   }
   virtual ~Logger() {
     // ...
@@ -207,6 +291,21 @@ public:
       write(m_log, report, length);
     }
   }
+};
+
+class Recorder : public Ticker { // logger only, without the car client
+private:
+  Serial m_S;
+
+public:
+  Recorder(Logger * L, const char * serial, bool verbose, bool fixbaud) :
+    m_S(L, serial, fixbaud, verbose)
+  {
+    set_sleeper(&m_S);
+  }
+  virtual ~Recorder() {
+    // ...
+  }
   virtual void tick() { // every millisecond
     Ticker::tick();
   }
@@ -223,39 +322,81 @@ int main(int argc, char ** argv) {
   bool verbose = false;
   bool fixbaud = false;
   bool logger  = false;
+  bool car     = false;
+  bool binary  = false;
+  bool broker  = false;
+
+  int rt_cpu = -2; // -2 for no real-time; -1 for real-time without pinning to a particular core
   
   for (int arg = 1; arg < argc; arg++) {
     if (strcmp(argv[arg], "--help") == 0) {
-      fprintf(stderr, "\n%s [--help] [--verbose] [/dev/<ID>]\n\n", argv[0]);
+      fprintf(stderr, "\n%s [--help] [--verbose] [--car] [--logger] [--binary] [--broker] [--fix-baud] [--realtime[=<cpu>]] [/dev/<ID>]\n\n", argv[0]);
       fprintf(stderr, "  --help     Display this help.\n");
       fprintf(stderr, "  --verbose  Print debugging info.\n");
+      fprintf(stderr, "  --binary   Publish car telemetry in compact binary form.\n");
+      fprintf(stderr, "  --broker   Run an embedded MQTT broker (WebSocket & HTTP on %d; MQTT on %d) instead of using mosquitto.\n", CARIOT_WS_PORT, CARIOT_MQTT_PORT);
       fprintf(stderr, "  --fix-baud Fix the BAUD rate as 115200.\n");
-      fprintf(stderr, "  --logger   Run as a data logger.\n");
+      fprintf(stderr, "  --car      Run as the car client (the default, unless --logger).\n");
+      fprintf(stderr, "  --logger   Run as a data logger; with --car, both share the device.\n");
+      fprintf(stderr, "  --realtime Lock memory, pin to core <cpu> [%d] (-1 for any) and use SCHED_FIFO; reports tick jitter before & after.\n", CARIOT_RT_CPU);
       fprintf(stderr, "  /dev/<ID>  Connect to /dev/<ID> instead of default [/dev/ttyACM0].\n\n");
       return 0;
     }
     if (strcmp(argv[arg], "--verbose") == 0) {
       verbose = true;
+    } else if (strcmp(argv[arg], "--binary") == 0) {
+      binary = true;
+    } else if (strcmp(argv[arg], "--broker") == 0) {
+      broker = true;
     } else if (strcmp(argv[arg], "--fix-baud") == 0) {
       fixbaud = true;
+    } else if (strcmp(argv[arg], "--car") == 0) {
+      car = true;
     } else if (strcmp(argv[arg], "--logger") == 0) {
       logger = true;
+    } else if (strcmp(argv[arg], "--realtime") == 0) {
+      rt_cpu = CARIOT_RT_CPU;
+    } else if (strncmp(argv[arg], "--realtime=", 11) == 0) {
+      rt_cpu = atoi(argv[arg] + 11);
+      if (rt_cpu < -1) {
+	rt_cpu = -1;
+      }
     } else if (strncmp(argv[arg], "/dev/", 5) == 0) {
       serial = argv[arg];
     } else {
-      fprintf(stderr, "%s [--help] [--verbose] [--logger] [--fix-baud] [/dev/ID]\n", argv[0]);
+      fprintf(stderr, "%s [--help] [--verbose] [--car] [--logger] [--binary] [--broker] [--fix-baud] [--realtime[=<cpu>]] [/dev/ID]\n", argv[0]);
       return -1;
     }
   }
 
+  Logger L;
+
   if (logger) {
     if (!fork()) {
       loglist();
       exit(0);
     }
-    Logger(serial, verbose, fixbaud).loop();
+  }
+  if (logger && !car) {
+    Recorder R(&L, serial, verbose, fixbaud);
+    if (rt_cpu > -2) {
+      R.realtime_request(rt_cpu, CARIOT_RT_PRIORITY);
+    }
+    R.loop();
   } else {
-    Car(serial, verbose, fixbaud).loop();
+    Car C(serial, verbose, fixbaud, binary, logger ? &L : 0);
+    if (broker) {
+      Broker * B = new Broker(CARIOT_WEBDIR, CARIOT_WS_PORT, CARIOT_MQTT_PORT, verbose);
+      if (!B->listening()) {
+	fprintf(stderr, "car: embedded broker unavailable - is mosquitto running?\n");
+	return -1;
+      }
+      C.use_broker(B);
+    }
+    if (rt_cpu > -2) {
+      C.realtime_request(rt_cpu, CARIOT_RT_PRIORITY);
+    }
+    C.loop();
   }
   return 0;
 }
@@ -0,0 +1,34 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+#include "Arduino.h"
+
+unsigned long host_clock = 0;
+
+volatile uint32_t host_port = 0;
+
+void (*host_isr[HOST_PINS])() = { 0 };
+
+unsigned long micros() {
+  return host_clock;
+}
+
+unsigned long millis() {
+  return host_clock / 1000;
+}
+
+void yield() {
+  // ...
+}
+
+void pinMode(int pin, int mode) {
+  if (mode == INPUT_PULLUP) {
+    host_port |= digitalPinToBitMask(pin);
+  }
+}
+
+void attachInterrupt(int interrupt, void (*isr)(), int mode) {
+  host_isr[interrupt % HOST_PINS] = isr;
+}
@@ -0,0 +1,55 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+/* Just enough of the Arduino core to build firmware sources on a host. Time is virtual: micros() and
+ * millis() read host_clock, which a test advances as it pleases (see Arduino.cc). All pins are on one
+ * simulated input port, host_port, bit n for pin n; a test sets the bits and then calls the interrupt
+ * handler attached to the pin, host_isr[pin]. Stream is the interface only; a test supplies the bytes.
+ */
+
+#ifndef cariot_test_Arduino_h
+#define cariot_test_Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#define PI 3.1415926535897932384626433832795
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+#define CHANGE       1
+
+#define HOST_PINS 32
+
+extern unsigned long host_clock;   // microseconds
+extern volatile uint32_t host_port;
+extern void (*host_isr[HOST_PINS])();
+
+unsigned long micros();
+unsigned long millis();
+void yield();
+
+void pinMode(int pin, int mode);
+void attachInterrupt(int interrupt, void (*isr)(), int mode);
+
+class Stream {
+public:
+  virtual ~Stream() { }
+
+  virtual int available() = 0;
+  virtual int read() = 0;
+};
+
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline int digitalPinToPort(int pin) { return 0; }
+inline uint32_t digitalPinToBitMask(int pin) { return 1UL << (pin % HOST_PINS); }
+inline volatile uint32_t * portInputRegister(int port) { return &host_port; }
+
+#endif /* !cariot_test_Arduino_h */
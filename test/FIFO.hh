@@ -6,6 +6,13 @@
 #ifndef cariot_FIFO_hh
 #define cariot_FIFO_hh
 
+/* The FIFO<T> that Ring<T, N> replaced in the firmware, as it was, kept here only so that ring_bench can
+ * compare the two.
+ */
+#ifndef FIFO_BUFSIZE
+#define FIFO_BUFSIZE 256
+#endif
+
 /** FIFO is a byte buffer where bytes are added and removed in first-in first-out order.
  */
 template <typename T>
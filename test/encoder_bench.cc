@@ -0,0 +1,209 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+/* encoder_bench: the four-encoder bank on simulated pins. First the quadrature decoder, with random legal
+ * steps in both directions and some illegal (missed) edges; then the interrupt load, with all four encoders
+ * driven at increasing edge rates on the virtual clock and synced at 1 kHz as by the control interrupt,
+ * checking the speed estimates and the edges dropped; and last the host time per interrupt and per sync.
+ *
+ * A host can't count Teensy cycles, so the time per interrupt is the host's; the sustainable rate in the
+ * design itself is where the edge ring fills between syncs, ENCODER_EDGES edges per control cycle.
+ */
+
+#include <chrono>
+
+#include "config.hh"
+#include "Encoders.hh"
+
+#define BENCH_SYNC   1000   // microseconds between syncs, i.e., a 1 kHz control loop
+#define BENCH_EDGES  (1 << 24)
+
+static const int s_pin_A[4] = { E1_ChA, E2_ChA, E3_ChA, E4_ChA };
+static const int s_pin_B[4] = { E1_ChB, E2_ChB, E3_ChB, E4_ChB };
+
+static const unsigned char s_sequence[4] = { 0, 1, 3, 2 }; // (A << 1) | B, B leading A, i.e., positive
+
+static int s_phase[4] = { 0, 0, 0, 0 };
+
+static const int s_signs[] = ENCODER_SIGNS;
+
+/* Move encoder e one step, or two (i.e., an edge missed) if bSkip, and run its interrupt as the pins would
+ */
+static void s_step(int e, int direction, bool bSkip = false) {
+  s_phase[e] = (s_phase[e] + (bSkip ? 2 : 1) * direction) & 3;
+
+  unsigned char state = s_sequence[s_phase[e]];
+  uint32_t port = host_port;
+
+  port = (state & 2) ? (port | digitalPinToBitMask(s_pin_A[e])) : (port & ~digitalPinToBitMask(s_pin_A[e]));
+  port = (state & 1) ? (port | digitalPinToBitMask(s_pin_B[e])) : (port & ~digitalPinToBitMask(s_pin_B[e]));
+  host_port = port;
+
+  host_isr[s_pin_A[e]](); // either pin's handler will do
+}
+
+static void s_reset() {
+  host_port = 0;
+  for (int e = 0; e < 4; e++) {
+    s_phase[e] = 0;
+  }
+}
+
+static unsigned long s_seed = 1;
+
+static unsigned s_random() {
+  s_seed = s_seed * 1103515245UL + 12345UL;
+  return (unsigned) (s_seed >> 16) & 0x7FFF;
+}
+
+/* Random walk on encoder 0; the speed estimate must have the sign of the last run of steps, and the
+ * missed edges must be counted
+ */
+static bool s_check_decoder() {
+  unsigned long illegal = 0;
+  bool bOK = true;
+
+  for (int run = 0; run < 200; run++) {
+    int direction = (s_random() & 1) ? 1 : -1;
+    int steps = 20 + s_random() % 50;
+
+    for (int i = 0; i < steps; i++) {
+      host_clock += 100;
+      bool bSkip = (s_random() % 97 == 0);
+      s_step(0, direction, bSkip);
+      if (bSkip) {
+        ++illegal;
+      }
+    }
+    host_clock += 100;
+    Encoders.sync();
+
+    float expected = (float) (s_signs[0] * direction);
+    if (Encoders.latest(0) * expected <= 0) {
+      fprintf(stdout, "decoder: run %d: direction %d, estimate %f rev/s\n", run, direction, Encoders.latest(0));
+      bOK = false;
+    }
+  }
+  const Encoder::Quality & Q = Encoders.encoder(0).quality();
+  if (Q.illegal != illegal) {
+    fprintf(stdout, "decoder: %lu illegal transitions counted; expected %lu\n", Q.illegal, illegal);
+    bOK = false;
+  }
+  fprintf(stdout, "decoder: %s (%lu missed edges detected)\n", bOK ? "OK" : "FAILED", Q.illegal);
+  return bOK;
+}
+
+/* One virtual second with all four encoders at rate edges per second (in different directions & at slightly
+ * different speeds), synced every BENCH_SYNC microseconds; returns the worst relative speed error
+ */
+static float s_load(double rate, unsigned long & dropped) {
+  static const double scale[4] = { 1.0, 0.9, -0.8, -0.7 };
+
+  double period[4];
+  double next[4];
+  for (int e = 0; e < 4; e++) {
+    period[e] = 1E6 / (rate * fabs(scale[e]));
+    next[e] = period[e] * (e + 1) / 5; // out of step with each other
+  }
+
+  unsigned long dropped_before[4];
+  for (int e = 0; e < 4; e++) {
+    dropped_before[e] = Encoders.encoder(e).quality().dropped;
+  }
+
+  double start = (double) host_clock;
+  double sync = start + BENCH_SYNC;
+  float worst = 0;
+
+  while (sync - start <= 1E6) {
+    int e_next = 0;
+    for (int e = 1; e < 4; e++) {
+      if (next[e] < next[e_next]) {
+        e_next = e;
+      }
+    }
+    if (next[e_next] + start < sync) {
+      host_clock = (unsigned long) (start + next[e_next]);
+      s_step(e_next, (scale[e_next] < 0) ? -1 : 1);
+      next[e_next] += period[e_next];
+    } else {
+      host_clock = (unsigned long) sync;
+      Encoders.sync();
+      sync += BENCH_SYNC;
+
+      if (sync - start > 2E5) { // after 200 ms
+        for (int e = 0; e < 4; e++) {
+          float expected = (float) (s_signs[e] * rate * scale[e] / (4.0 * ENCODER_PPR));
+          float error = fabsf(Encoders.latest(e) - expected) / fabsf(expected);
+          if (error > worst) {
+            worst = error;
+          }
+        }
+      }
+    }
+  }
+
+  dropped = 0;
+  for (int e = 0; e < 4; e++) {
+    dropped += Encoders.encoder(e).quality().dropped - dropped_before[e];
+  }
+  return worst;
+}
+
+int main() {
+  const int wheels[] = ENCODER_WHEELS;
+
+  s_reset();
+  Encoders.init(ENCODER_PPR, wheels, s_signs);
+
+  bool bOK = s_check_decoder();
+
+  const double ring_limit = (double) ENCODER_EDGES * (1E6 / BENCH_SYNC); // edges per second per encoder
+  const double rates[] = { 1E3, 1E4, 3E4, 6E4, 1E5, 2E5 };
+
+  for (int r = 0; r < 6; r++) {
+    unsigned long dropped;
+    float worst = s_load(rates[r], dropped);
+
+    fprintf(stdout, "load: %6.0f edges/s per encoder (%4.1f rev/s): speed error %.4f%%, %lu timestamps dropped\n",
+            rates[r], rates[r] / (4.0 * ENCODER_PPR), worst * 100, dropped);
+
+    if (worst > 0.01) { // dropped timestamps only shorten the history; the estimate must stay good
+      bOK = false;
+    }
+    if (rates[r] < ring_limit && dropped) {
+      bOK = false;
+    }
+  }
+  fprintf(stdout, "load: the edge ring holds %d edges per sync, i.e., up to %.0f edges/s per encoder at %d Hz\n",
+          ENCODER_EDGES, ring_limit, 1000000 / BENCH_SYNC);
+
+  /* Host time per interrupt, and per sync of all four
+   */
+  auto start = std::chrono::steady_clock::now();
+  for (long n = 0; n < BENCH_EDGES; n++) {
+    ++host_clock;
+    s_step(n & 3, 1);
+    if ((n & 63) == 63) { // keep the edge rings from filling; the cost of the syncs is taken off below
+      Encoders.sync();
+    }
+  }
+  double t_total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (long n = 0; n < BENCH_EDGES / 64; n++) {
+    host_clock += 10;
+    Encoders.sync();
+  }
+  double t_sync = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double ns_sync = t_sync * 1E9 / (BENCH_EDGES / 64);
+  double ns_edge = (t_total * 1E9 - ns_sync * (BENCH_EDGES / 64)) / BENCH_EDGES;
+
+  fprintf(stdout, "host: %.1f ns per edge interrupt, %.1f ns per sync of four encoders\n", ns_edge, ns_sync);
+
+  fprintf(stdout, "encoder_bench: %s\n", bOK ? "OK" : "FAILED");
+  return bOK ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+/* format_bench: Format against the snprintf() calls it replaced. First the output, field by field on random
+ * values, and as whole report lines through a Commander's output ring as it wraps around; then the time per
+ * report line, snprintf() & ui_print() against Format straight into the ring.
+ *
+ * Format's arithmetic is on 32-bit values, as on the boards, so the values here are in that range. Exact
+ * rounding ties may go either way, since Format rounds half away from zero and printf half to even; and
+ * fixed(float) scales the fraction in float, so where that is within float rounding of a half, the last
+ * digit may be one off. Both are counted and allowed; anything else is wrong.
+ *
+ * Code size is another matter: "make sizes" shows Format's on the host, but what it saves on a board is
+ * the float printf in newlib, which needs the ARM toolchain to measure.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <chrono>
+#include <string>
+
+#include "config.hh"
+#include "Format.hh"
+
+#define BENCH_VALUES 200000 // random values per field type
+#define BENCH_LINES  (1 << 20)
+
+class HostCommander : public Commander {
+public:
+  HostCommander() : Commander(0, 0) { }
+
+  std::string take() { // everything written so far
+    std::string output;
+    char buffer[COMMANDER_BUFSIZE];
+    int count;
+    while ((count = m_fifo.read(buffer, sizeof(buffer))) > 0) {
+      output.append(buffer, count);
+    }
+    return output;
+  }
+  void discard() {
+    const char * span;
+    int count;
+    while ((count = m_fifo.peek_span(span)) > 0) {
+      m_fifo.consume(count);
+    }
+  }
+};
+
+static unsigned long s_seed = 1;
+
+static uint32_t s_random32() {
+  uint32_t value = 0;
+  for (int i = 0; i < 3; i++) {
+    s_seed = s_seed * 1103515245UL + 12345UL;
+    value = (value << 15) | (uint32_t) ((s_seed >> 16) & 0x7FFF);
+  }
+  return value;
+}
+
+static long s_random_long() { // spread over all magnitudes of a 32-bit long
+  int32_t value = (int32_t) s_random32();
+  return (long) (value >> (s_random32() % 32));
+}
+
+struct Tally {
+  unsigned long count;
+  unsigned long ties; // differences in rounding a half, allowed
+  unsigned long bad;
+
+  /* unit, if not zero: a tie may only make the last digit one off
+   */
+  void check(const char * name, const char * format, const char * expected, bool bTie, double unit = 0) {
+    ++count;
+    if (strcmp(format, expected)) {
+      if (bTie && (!unit || fabs(strtod(format, 0) - strtod(expected, 0)) <= unit * 1.01)) {
+        ++ties;
+      } else if (++bad <= 5) {
+        fprintf(stdout, "  %s: \"%s\", expected \"%s\"\n", name, format, expected);
+      }
+    }
+  }
+  bool report(const char * name) {
+    fprintf(stdout, "%-15s %7lu values, %5lu at ties, %lu wrong\n", name, count, ties, bad);
+    return !bad;
+  }
+};
+
+/* Is v x 10^decimals a half, give or take the rounding of the float multiply in fixed(), which scales
+ * only the fraction?
+ */
+static bool s_tie(double v, int decimals) {
+  double fraction = fabs(v) - floor(fabs(v));
+  double scaled = fraction * pow(10, decimals);
+  return fabs(scaled - floor(scaled) - 0.5) <= pow(10, decimals) * FLT_EPSILON;
+}
+
+static bool s_check_fields() {
+  char format[64];
+  char expected[64];
+  bool bOK = true;
+
+  Tally T = { 0, 0, 0 };
+  for (int i = 0; i < BENCH_VALUES; i++) {
+    long value = s_random_long();
+    int width = s_random32() % 12;
+    bool bZero = s_random32() & 1;
+    Format(format, 64).dec(value, width, bZero ? '0' : ' ');
+    snprintf(expected, 64, bZero ? "%0*ld" : "%*ld", width, value);
+    T.check("dec", format, expected, false);
+
+    unsigned long u = (unsigned long) s_random32() >> (s_random32() % 32);
+    Format(format, 64).udec(u, width, bZero ? '0' : ' ');
+    snprintf(expected, 64, bZero ? "%0*lu" : "%*lu", width, u);
+    T.check("udec", format, expected, false);
+
+    Format(format, 64).hex(u);
+    snprintf(expected, 64, "%lx", u);
+    T.check("hex", format, expected, false);
+  }
+  bOK = T.report("dec/udec/hex") && bOK;
+
+  T = (Tally) { 0, 0, 0 };
+  for (int i = 0; i < BENCH_VALUES; i++) {
+    int decimals = s_random32() % (FORMAT_DECIMALS_MAX + 1);
+    int width = s_random32() % 12;
+    float value = (float) s_random_long() / (float) pow(10, s_random32() % 10);
+    if (fabs(value) * pow(10, decimals) >= 4E9) {
+      continue; // too big for Format's 32 bits
+    }
+    Format(format, 64).fixed(value, decimals, width);
+    snprintf(expected, 64, "%*.*f", width, decimals, (double) value);
+    if (!strcmp(expected + strlen(expected) - (decimals ? decimals + 2 : 1), "-0") ||
+        (strspn(expected, " -0.") == strlen(expected) && strchr(expected, '-'))) {
+      snprintf(expected, 64, "%*.*f", width, decimals, 0.0); // Format writes no "-0.00"
+    }
+    T.check("fixed(float)", format, expected, s_tie(value, decimals), pow(10, -decimals));
+  }
+  bOK = T.report("fixed(float)") && bOK;
+
+  T = (Tally) { 0, 0, 0 };
+  for (int i = 0; i < BENCH_VALUES; i++) {
+    long value = s_random_long() % 1800000000L; // degrees x 10^7
+    Format(format, 64).fixed(value, 7, 6);
+    snprintf(expected, 64, "%.6f", (double) value / 1E7);
+    if (!strcmp(expected, "-0.000000")) {
+      strcpy(expected, "0.000000");
+    }
+    T.check("fixed(long)", format, expected, (labs(value) % 10) == 5);
+
+    char hemisphere = (value < 0) ? 'S' : 'N';
+    double degrees = fabs((double) value / 1E7);
+    int whole = (int) degrees;
+    double minutes = (degrees - whole) * 60;
+    int m = (int) minutes;
+    double seconds = (minutes - m) * 60;
+    snprintf(expected, 64, "%3d^%02d'%.4f\"%c", whole, m, seconds, hemisphere);
+    bool bCarry = (strstr(expected, "'60.0000") != 0); // Format carries into the minutes
+    bool bTie = ((labs(value) % 10000000L) * 3600 % 1000) == 500; // seconds x 10^4 is exactly a half
+    Format(format, 64).dms(value, 'N', 'S');
+    T.check("dms", format, expected, bCarry || bTie);
+  }
+  bOK = T.report("fixed(long)/dms") && bOK;
+
+  return bOK;
+}
+
+/* The report lines, as every_10ms() writes them (see Buggy.ino)
+ */
+static void s_format_lines(Commander & C, int MSpeed, int M1, int M2, const float * v) {
+  Format(C).dec(MSpeed).ch(' ').dec(M1).ch('/').dec(M1 - 3).ch(' ').dec(M2).ch('/').dec(M2 + 2);
+  C.ui();
+  Format(C).fixed(v[0], 2, 6).ch(' ').fixed(v[1], 2, 6).ch(' ').fixed(v[2], 2, 6).ch(' ')
+           .fixed(v[3], 2, 6).ch(' ').fixed(v[4], 2, 6);
+  C.ui();
+}
+
+static void s_printf_lines(Commander & C, int MSpeed, int M1, int M2, const float * v) {
+  char buf[40];
+  snprintf(buf, 40, "%d %d/%d %d/%d", MSpeed, M1, M1 - 3, M2, M2 + 2);
+  C.ui_print(buf);
+  C.ui();
+  snprintf(buf, 40, "%6.2f %6.2f %6.2f %6.2f %6.2f", v[0], v[1], v[2], v[3], v[4]);
+  C.ui_print(buf);
+  C.ui();
+}
+
+static void s_values(int & MSpeed, int & M1, int & M2, float * v) {
+  MSpeed = (int) (s_random32() % 201) - 100;
+  M1 = (int) (s_random32() % 255) - 127;
+  M2 = (int) (s_random32() % 255) - 127;
+  for (int i = 0; i < 5; i++) {
+    v[i] = ((float) (int) (s_random32() % 20001) - 10000) / 100.0f + 0.001f; // km/h, never at a tie
+  }
+}
+
+static bool s_check_lines() {
+  HostCommander A;
+  HostCommander B;
+  unsigned long bad = 0;
+  unsigned long bytes = 0;
+
+  for (int i = 0; i < 10000; i++) {
+    int MSpeed, M1, M2;
+    float v[5];
+    s_values(MSpeed, M1, M2, v);
+
+    s_format_lines(A, MSpeed, M1, M2, v);
+    s_printf_lines(B, MSpeed, M1, M2, v);
+
+    std::string a = A.take();
+    std::string b = B.take();
+    bytes += a.size();
+    if (a != b && ++bad <= 5) {
+      fprintf(stdout, "  lines: \"%s\", expected \"%s\"\n", a.c_str(), b.c_str());
+    }
+  }
+  fprintf(stdout, "lines:       10000 pairs, %lu bytes through the ring (%lu wrap-arounds), %lu wrong\n",
+          bytes, bytes / COMMANDER_BUFSIZE, bad);
+  return !bad;
+}
+
+static void s_time_lines() {
+  HostCommander C;
+  int MSpeed, M1, M2;
+  float v[5];
+  s_values(MSpeed, M1, M2, v);
+
+  auto start = std::chrono::steady_clock::now();
+  for (long n = 0; n < BENCH_LINES; n++) {
+    v[n & 3] += 0.01f;
+    s_printf_lines(C, MSpeed, M1, M2, v);
+    C.discard();
+  }
+  double t_printf = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (long n = 0; n < BENCH_LINES; n++) {
+    v[n & 3] += 0.01f;
+    s_format_lines(C, MSpeed, M1, M2, v);
+    C.discard();
+  }
+  double t_format = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  fprintf(stdout, "host: report lines: snprintf & ui_print %.0f ns, Format %.0f ns per pair\n",
+          t_printf * 1E9 / BENCH_LINES, t_format * 1E9 / BENCH_LINES);
+}
+
+int main() {
+  bool bOK = s_check_fields();
+  bOK = s_check_lines() && bOK;
+
+  s_time_lines();
+
+  fprintf(stdout, "format_bench: %s\n", bOK ? "OK" : "FAILED");
+  return bOK ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+/* nmea_test: the streaming NMEA parser over data/gps.nmea, a 1 Hz RMC/GGA/GSA/GSV stream in the format of
+ * the MTK3339 (Adafruit Ultimate GPS), made up for the purpose. It starts without a fix (empty fields), loses
+ * the fix for two seconds, switches talker (GP/GN) and the order of RMC & GGA, has a bad checksum, a sentence
+ * cut short, one without a checksum, one with a checksum that isn't hex, line noise, a lower-case checksum,
+ * and positions north & west, south & east, south & west, and across the equator & the meridian.
+ *
+ * Each sentence is checked against a simple whole-sentence parser here; then the stream is parsed again
+ * through drain() in random-sized pieces, as it arrives from the serial port; then the time per character.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "config.hh"
+#include "NMEA.hh"
+
+#define BENCH_CHARS (1 << 26)
+
+/* The expected totals for data/gps.nmea, so that the reference parser can't simply agree with a mistake
+ */
+#define DATA_SENTENCES 103
+#define DATA_ERRORS    3
+#define DATA_IGNORED   69
+
+static unsigned long s_seed = 1;
+
+static unsigned s_random() {
+  s_seed = s_seed * 1103515245UL + 12345UL;
+  return (unsigned) (s_seed >> 16) & 0x7FFF;
+}
+
+static int s_hex(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+/* Whole-sentence reference: split on ',', convert with strtod
+ */
+class Reference {
+private:
+  static long s_degrees(const std::string & field) { // [d]ddmm.mmmm to degrees x 10^7
+    double value = strtod(field.c_str(), 0);
+    double degrees = floor(value / 100);
+    return lround((degrees + (value - degrees * 100) / 60) * 1E7);
+  }
+
+  void apply(int field, const std::string & f) {
+    NMEA::Fix & F = pending;
+
+    switch (field) {
+    case 1:
+      F.hour    = (uint8_t) atoi(f.substr(0, 2).c_str());
+      F.minute  = (uint8_t) atoi(f.substr(2, 2).c_str());
+      F.seconds = (uint8_t) atoi(f.substr(4, 2).c_str());
+      F.milliseconds = (f.size() > 7) ? (uint16_t) atoi((f.substr(7, 3) + "00").substr(0, 3).c_str()) : 0;
+      break;
+    case 2:
+      F.fix = (f[0] == 'A');
+      break;
+    case 3:
+      F.latitude = s_degrees(f);
+      break;
+    case 4:
+      F.latitude = (f[0] == 'S') ? -labs(F.latitude) : labs(F.latitude);
+      break;
+    case 5:
+      F.longitude = s_degrees(f);
+      break;
+    case 6:
+      F.longitude = (f[0] == 'W') ? -labs(F.longitude) : labs(F.longitude);
+      break;
+    case 9:
+      F.day   = (uint8_t) atoi(f.substr(0, 2).c_str());
+      F.month = (uint8_t) atoi(f.substr(2, 2).c_str());
+      F.year  = (uint8_t) atoi(f.substr(4, 2).c_str());
+      break;
+    case 16:
+      F.fix = (atoi(f.c_str()) > 0);
+      break;
+    case 17:
+      F.satellites = (uint8_t) atoi(f.c_str());
+      break;
+    default:
+      break;
+    }
+  }
+
+  void sentence(const std::string & body) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    size_t comma;
+    while ((comma = body.find(',', start)) != std::string::npos) {
+      fields.push_back(body.substr(start, comma - start));
+      start = comma + 1;
+    }
+    fields.push_back(body.substr(start));
+
+    std::string id = (fields[0].size() >= 3) ? fields[0].substr(fields[0].size() - 3) : fields[0];
+    bool bRMC = (id == "RMC");
+    bool bGGA = (id == "GGA");
+
+    if (!bRMC && !bGGA) {
+      ++stats.ignored;
+      return;
+    }
+    pending = fix;
+    for (size_t i = 1; i < fields.size(); i++) {
+      if (fields[i].empty()) {
+        continue; // i.e., keep the previous value
+      }
+      int field = (int) i;
+      if (bGGA && (field >= 2)) {
+        field = (field <= 5) ? (field + 1) : (field + 10);
+      }
+      apply(field, fields[i]);
+    }
+    fix = pending;
+    ++stats.sentences;
+  }
+
+public:
+  NMEA::Fix   fix;
+  NMEA::Fix   pending;
+  NMEA::Stats stats;
+
+  Reference() {
+    memset(&fix, 0, sizeof(fix));
+    memset(&stats, 0, sizeof(stats));
+  }
+
+  /* One segment, from a '$' up to (not including) the next '$' or the end; returns true if it was a
+   * valid RMC or GGA sentence
+   */
+  bool segment(const std::string & s) {
+    size_t eol  = s.find_first_of("\r\n");
+    size_t star = s.find('*');
+
+    if ((star == std::string::npos) || ((eol != std::string::npos) && (eol < star))) {
+      if (eol != std::string::npos) {
+        ++stats.errors; // no checksum
+      }
+      return false; // otherwise cut short by the next sentence, which isn't counted
+    }
+    int check = 0;
+    for (size_t i = star + 1; i < star + 3; i++) {
+      if (i >= s.size()) {
+        return false; // cut short
+      }
+      int digit = s_hex(s[i]);
+      if (digit < 0) {
+        ++stats.errors;
+        return false;
+      }
+      check = (check << 4) | digit;
+    }
+    int sum = 0;
+    for (size_t i = 1; i < star; i++) {
+      sum ^= (unsigned char) s[i];
+    }
+    if (sum != check) {
+      ++stats.errors;
+      return false;
+    }
+    unsigned long before = stats.sentences;
+    sentence(s.substr(1, star - 1));
+    return stats.sentences != before;
+  }
+};
+
+static bool s_same(const NMEA::Fix & a, const NMEA::Fix & b) {
+  return (a.hour == b.hour) && (a.minute == b.minute) && (a.seconds == b.seconds)
+      && (a.milliseconds == b.milliseconds)
+      && (a.day == b.day) && (a.month == b.month) && (a.year == b.year)
+      && (a.fix == b.fix) && (a.satellites == b.satellites)
+      && (labs(a.latitude - b.latitude) <= 1) && (labs(a.longitude - b.longitude) <= 1); // float rounding
+}
+
+static bool s_same(const NMEA::Stats & a, const NMEA::Stats & b) {
+  return (a.sentences == b.sentences) && (a.errors == b.errors) && (a.ignored == b.ignored);
+}
+
+static void s_print(const char * name, const NMEA::Fix & F) {
+  fprintf(stdout, "  %s: %02d:%02d:%02d.%03d %02d/%02d/%02d fix %d sats %2d, %ld, %ld\n", name,
+          F.hour, F.minute, F.seconds, F.milliseconds, F.day, F.month, F.year, F.fix, F.satellites,
+          F.latitude, F.longitude);
+}
+
+/* A byte stream that makes a random number of bytes available at a time, as a serial port would
+ */
+class Capture : public Stream {
+private:
+  const std::string & m_data;
+  size_t m_next;
+  size_t m_end;
+public:
+  Capture(const std::string & data) : m_data(data), m_next(0), m_end(0) { }
+
+  bool arrive() { // more bytes; returns false at the end
+    if (m_end >= m_data.size()) {
+      return false;
+    }
+    m_end += 1 + s_random() % 96;
+    if (m_end > m_data.size()) {
+      m_end = m_data.size();
+    }
+    return true;
+  }
+
+  virtual int available() { return (int) (m_end - m_next); }
+  virtual int read()      { return (m_next < m_end) ? (unsigned char) m_data[m_next++] : -1; }
+};
+
+static bool s_load(const char * path, std::string & data) {
+  FILE * file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stdout, "nmea_test: unable to open %s\n", path);
+    return false;
+  }
+  char buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.append(buffer, count);
+  }
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char ** argv) {
+  std::string data;
+  if (!s_load((argc > 1) ? argv[1] : "data/gps.nmea", data)) {
+    return 1;
+  }
+  bool bOK = true;
+
+  /* Byte by byte, each sentence against the reference
+   */
+  NMEA nmea;
+  Reference R;
+  unsigned long mismatches = 0;
+  bool bNW = false;
+  bool bSE = false;
+  bool bSW = false;
+
+  size_t start = data.find('$');
+  while (start != std::string::npos) {
+    size_t next = data.find('$', start + 1);
+    std::string segment = data.substr(start, (next == std::string::npos) ? std::string::npos : (next - start));
+
+    bool bRef = R.segment(segment);
+    bool bValid = false;
+    for (size_t i = 0; i < segment.size(); i++) {
+      bValid = nmea.put(segment[i]) || bValid;
+    }
+    if ((bValid != bRef) || !s_same(nmea.fix(), R.fix)) {
+      if (++mismatches <= 5) {
+        fprintf(stdout, "mismatch at offset %lu: %s", (unsigned long) start, segment.c_str());
+        s_print("parser   ", nmea.fix());
+        s_print("reference", R.fix);
+      }
+    }
+    if (bValid && nmea.fix().fix) {
+      const NMEA::Fix & F = nmea.fix();
+      bNW = bNW || ((F.latitude > 0) && (F.longitude < 0));
+      bSE = bSE || ((F.latitude < 0) && (F.longitude > 0));
+      bSW = bSW || ((F.latitude < 0) && (F.longitude < 0));
+    }
+    start = next;
+  }
+  const NMEA::Stats & S = nmea.stats();
+  fprintf(stdout, "sentences: %lu accepted, %lu errors, %lu ignored; %lu mismatches with the reference\n",
+          S.sentences, S.errors, S.ignored, mismatches);
+
+  if (mismatches || !s_same(S, R.stats)) {
+    bOK = false;
+  }
+  if ((S.sentences != DATA_SENTENCES) || (S.errors != DATA_ERRORS) || (S.ignored != DATA_IGNORED)) {
+    fprintf(stdout, "  FAIL: expected %d accepted, %d errors, %d ignored\n", DATA_SENTENCES, DATA_ERRORS, DATA_IGNORED);
+    bOK = false;
+  }
+  if (!bNW || !bSE || !bSW) {
+    fprintf(stdout, "  FAIL: fixes in every hemisphere expected\n");
+    bOK = false;
+  }
+
+  /* The last fix is just south of the equator & east of the meridian: 0.0018' is 0.00003 degrees
+   */
+  const NMEA::Fix & F = nmea.fix();
+  if ((F.latitude != -300) || (F.longitude != 300) || !F.fix || (F.satellites != 8) ||
+      (F.hour != 12) || (F.minute != 35) || (F.seconds != 42) || (F.day != 19) || (F.month != 5) || (F.year != 21)) {
+    s_print("FAIL: last fix", F);
+    bOK = false;
+  }
+
+  /* Again, through drain(), in random-sized pieces
+   */
+  NMEA streamed;
+  Capture C(data);
+  int drained = 0;
+  while (C.arrive()) {
+    drained += streamed.drain(C);
+  }
+  bool bStreamed = ((unsigned long) drained == S.sentences) && s_same(streamed.stats(), S) && s_same(streamed.fix(), F);
+  fprintf(stdout, "drain: %d sentences in random pieces: %s\n", drained, bStreamed ? "OK" : "FAILED");
+  bOK = bOK && bStreamed;
+
+  /* Throughput
+   */
+  NMEA bench;
+  long chars = 0;
+  auto t_start = std::chrono::steady_clock::now();
+  while (chars < BENCH_CHARS) {
+    for (size_t i = 0; i < data.size(); i++) {
+      bench.put(data[i]);
+    }
+    chars += (long) data.size();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+  fprintf(stdout, "host: %.2f ns per character, %.0f MB/s (the GPS sends about 1 kB/s at 9600 baud)\n",
+          seconds * 1E9 / chars, chars / seconds / 1E6);
+
+  fprintf(stdout, "nmea_test: %s\n", bOK ? "OK" : "FAILED");
+  return bOK ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+/* pid_test: PID<float> and PID<Fixed> against the float update that MC::update() did before, over an error
+ * sequence recorded from a simulated motor under that baseline controller (target steps, sensor noise and
+ * a jittery interval, as the control interrupt measures it); then the time per update of each.
+ *
+ * The host has an FPU, so the timings show the cost of the arithmetic here and not the software float of a
+ * Cortex-M0+; M0 cycle counts need the board itself (e.g., SysTick around update()).
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <vector>
+
+#include "Fixed.hh"
+#include "PID.hh"
+
+#define TEST_STEPS   6000     // control cycles in the recorded sequence, about a minute
+#define BENCH_CYCLES (1 << 24)
+
+struct Gains {
+  const char * name;
+  float P;
+  float I;
+  float D;
+};
+
+struct Sample {
+  float error;
+  float dt_ms;
+};
+
+/* The float update as it was in MC::update(), dividing by dt each time
+ */
+class Baseline {
+private:
+  float m_error_old;
+  float m_integral;
+public:
+  Baseline() : m_error_old(0), m_integral(0) { }
+
+  float update(const Gains & G, float error, float dt_ms) {
+    float difference = (error - m_error_old) / dt_ms;
+
+    m_integral += ((error + m_error_old) / 2) * dt_ms;
+    m_error_old = error;
+
+    return G.P * error + G.I * m_integral + G.D * difference;
+  }
+};
+
+static unsigned long s_seed = 1;
+
+static float s_noise() { // uniform in [-1, 1]
+  s_seed = s_seed * 1103515245UL + 12345UL;
+  return (float) ((s_seed >> 16) & 0x7FFF) / 16383.5f - 1.0f;
+}
+
+/* A motor as a first-order lag from command to speed, under the baseline controller; the errors it saw
+ * and the intervals it measured are the recording
+ */
+static std::vector<Sample> s_record(const Gains & G) {
+  static const float targets[] = { 0, 5, 10, 2, -3, 0 }; // km/h, in equal stages
+
+  std::vector<Sample> samples;
+  Baseline B;
+  float speed = 0;
+
+  s_seed = 1;
+  for (int n = 0; n < TEST_STEPS; n++) {
+    Sample S;
+    S.dt_ms = 10.0f + 0.2f * s_noise();                        // measured interval
+    S.error = targets[n * 6 / TEST_STEPS] - speed + 0.05f * s_noise(); // noisy encoder
+
+    float command = (float) (int) B.update(G, S.error, S.dt_ms);
+    if (command >  127) command =  127;
+    if (command < -127) command = -127;
+
+    speed += (0.1f * command - speed) * S.dt_ms / 200.0f; // 0.1 km/h per unit of command; 200 ms lag
+    samples.push_back(S);
+  }
+  return samples;
+}
+
+struct Error {
+  double max;      // largest difference from the baseline
+  double scale;    // largest baseline output
+  int    commands; // motor commands differing by more than one
+};
+
+template <typename T>
+static Error s_compare(const Gains & G, const std::vector<Sample> & samples) {
+  Baseline B;
+  PID<T> pid;
+  Error E = { 0, 0, 0 };
+
+  for (size_t n = 0; n < samples.size(); n++) {
+    float expected = B.update(G, samples[n].error, samples[n].dt_ms);
+
+    pid.tune(G.P, G.I, G.D, samples[n].dt_ms);
+    float actual = (float) pid.update(T(samples[n].error));
+
+    double difference = fabs((double) actual - expected);
+    if (difference > E.max) {
+      E.max = difference;
+    }
+    if (fabs(expected) > E.scale) {
+      E.scale = fabs(expected);
+    }
+    int c_expected = (int) expected;
+    int c_actual   = (int) actual;
+    if (c_actual - c_expected > 1 || c_expected - c_actual > 1) {
+      ++E.commands;
+    }
+  }
+  return E;
+}
+
+template <typename T>
+static double s_time(const Gains & G, const std::vector<Sample> & samples) {
+  std::vector<T> errors;
+  for (size_t n = 0; n < samples.size(); n++) {
+    errors.push_back(T(samples[n].error));
+  }
+  PID<T> pid;
+  pid.tune(G.P, G.I, G.D, 10);
+
+  volatile int sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (long n = 0; n < BENCH_CYCLES; n++) {
+    sink = sink + (int) pid.update(errors[n % errors.size()]);
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double s_time_baseline(const Gains & G, const std::vector<Sample> & samples) {
+  Baseline B;
+  volatile int sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (long n = 0; n < BENCH_CYCLES; n++) {
+    sink = sink + (int) B.update(G, samples[n % samples.size()].error, 10);
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+  const Gains gains[] = {
+    { "P only", 1.00f, 0.000f,  0.0f }, // the default MC_Params
+    { "PI",     8.00f, 0.010f,  0.0f },
+    { "PID",    5.00f, 0.005f, 20.0f },
+  };
+  bool bOK = true;
+
+  for (int g = 0; g < 3; g++) {
+    const Gains & G = gains[g];
+    std::vector<Sample> samples = s_record(G);
+
+    Error F = s_compare<float>(G, samples);
+    Error X = s_compare<Fixed>(G, samples);
+
+    /* float differs from the baseline only in rounding; Q16.16 by about its resolution times the gains,
+     * plus the rounding of the integral, so allow a thousandth of the output range, and no command off by
+     * more than the one that truncation can give
+     */
+    bool bFloat = (F.max <= 1E-4 * F.scale + 1E-3) && !F.commands;
+    bool bFixed = (X.max <= 1E-3 * X.scale + 5E-3) && !X.commands;
+
+    fprintf(stdout, "%-6s: output up to %6.1f; float differs by %.2e, Q16.16 by %.2e: %s\n",
+            G.name, F.scale, F.max, X.max, (bFloat && bFixed) ? "OK" : "FAILED");
+
+    bOK = bOK && bFloat && bFixed;
+  }
+
+  std::vector<Sample> samples = s_record(gains[2]);
+  double t_base  = s_time_baseline(gains[2], samples);
+  double t_float = s_time<float>(gains[2], samples);
+  double t_fixed = s_time<Fixed>(gains[2], samples);
+
+  fprintf(stdout, "host: baseline %.2f ns, PID<float> %.2f ns, PID<Fixed> %.2f ns per update\n",
+          t_base * 1E9 / BENCH_CYCLES, t_float * 1E9 / BENCH_CYCLES, t_fixed * 1E9 / BENCH_CYCLES);
+
+  fprintf(stdout, "pid_test: %s\n", bOK ? "OK" : "FAILED");
+  return bOK ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+/* ring_bench: Ring<char, 256> against the FIFO<char> it replaced, on the same byte streams - first for
+ * correctness, against a reference queue, then for speed, a byte at a time and in bulk; and Ring alone with
+ * a producer and a consumer thread, as an interrupt and the main loop would use it.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <deque>
+#include <thread>
+
+#include "FIFO.hh"
+#include "Ring.hh"
+
+#define BENCH_SIZE    256       // FIFO_BUFSIZE, as in the firmware
+#define BENCH_BYTES   (1 << 26) // bytes per timed stream
+#define THREAD_BYTES  (1 << 24) // bytes passed between threads
+
+typedef Ring<char, BENCH_SIZE> ring_t;
+typedef FIFO<char>             fifo_t;
+
+static unsigned long s_seed = 1;
+
+static unsigned s_random() { // deterministic, so that both buffers see the same stream
+  s_seed = s_seed * 1103515245UL + 12345UL;
+  return (unsigned) (s_seed >> 16) & 0x7FFF;
+}
+
+static double s_seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Random pushes & pops, checked against a reference queue; returns the number of mismatches
+ */
+template <typename B>
+static unsigned long s_check_bytes(B & buffer, int iterations) {
+  std::deque<char> reference;
+  unsigned long errors = 0;
+  char next = 0;
+
+  s_seed = 1;
+  for (int i = 0; i < iterations; i++) {
+    int count = s_random() % 64;
+    if (s_random() & 1) {
+      while (count--) {
+        if (buffer.push(next)) {
+          reference.push_back(next);
+        }
+        ++next;
+      }
+    } else {
+      char c;
+      while (count-- && buffer.pop(c)) {
+        if (reference.empty() || reference.front() != c) {
+          ++errors;
+        } else {
+          reference.pop_front();
+        }
+      }
+    }
+  }
+  return errors;
+}
+
+/* Random bulk writes & reads, checked against a reference queue; returns the number of mismatches
+ */
+template <typename B>
+static unsigned long s_check_bulk(B & buffer, int iterations) {
+  std::deque<char> reference;
+  unsigned long errors = 0;
+  char next = 0;
+  char chunk[BENCH_SIZE];
+
+  s_seed = 2;
+  for (int i = 0; i < iterations; i++) {
+    int length = 1 + s_random() % (BENCH_SIZE - 1);
+    if (s_random() & 1) {
+      for (int c = 0; c < length; c++) {
+        chunk[c] = next++;
+      }
+      int count = buffer.write(chunk, length);
+      for (int c = 0; c < count; c++) {
+        reference.push_back(chunk[c]);
+      }
+      next -= (char) (length - count);
+    } else {
+      int count = buffer.read(chunk, length);
+      for (int c = 0; c < count; c++) {
+        if (reference.empty() || reference.front() != chunk[c]) {
+          ++errors;
+        } else {
+          reference.pop_front();
+        }
+      }
+    }
+  }
+  return errors;
+}
+
+template <typename B>
+static double s_time_bytes(B & buffer) {
+  volatile char sink = 0;
+  char c = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (long n = 0; n < BENCH_BYTES; n += 192) {
+    for (int i = 0; i < 192; i++) {
+      buffer.push((char) i);
+    }
+    while (buffer.pop(c)) {
+      sink = sink + c;
+    }
+  }
+  return s_seconds(start);
+}
+
+template <typename B>
+static double s_time_bulk(B & buffer) {
+  static const int lengths[] = { 1, 7, 16, 64, 100, 31 }; // writes wrap around at different places
+  char chunk[BENCH_SIZE];
+
+  memset(chunk, 'x', sizeof(chunk));
+
+  auto start = std::chrono::steady_clock::now();
+  for (long n = 0, i = 0; n < BENCH_BYTES; i++) {
+    int length = lengths[i % 6];
+    n += buffer.write(chunk, length);
+    buffer.read(chunk, length);
+  }
+  return s_seconds(start);
+}
+
+/* One producer thread and one consumer thread, with nothing but the ring between them
+ */
+static bool s_check_threads() {
+  static ring_t ring;
+  unsigned long errors = 0;
+
+  std::thread producer([] {
+    unsigned char next = 0;
+    for (long n = 0; n < THREAD_BYTES; ) {
+      char * span;
+      int count = ring.reserve_span(span);
+      if (!count) {
+        std::this_thread::yield(); // full; there may be only one core
+        continue;
+      }
+      if (count > 13) {
+        count = 13; // odd sizes, so that spans wrap around anywhere
+      }
+      for (int i = 0; i < count; i++) {
+        span[i] = (char) next++;
+      }
+      ring.commit(count);
+      n += count;
+      if (n < THREAD_BYTES && ring.push((char) next)) {
+        ++next;
+        ++n;
+      }
+    }
+  });
+
+  unsigned char expected = 0;
+  for (long n = 0; n < THREAD_BYTES; ) {
+    const char * span;
+    int count = ring.peek_span(span);
+    if (!count) {
+      std::this_thread::yield(); // empty
+      continue;
+    }
+    for (int i = 0; i < count; i++) {
+      if ((unsigned char) span[i] != expected++) {
+        ++errors;
+      }
+    }
+    ring.consume(count);
+    n += count;
+  }
+  producer.join();
+
+  fprintf(stdout, "ring: threads: %d bytes, %lu errors\n", THREAD_BYTES, errors);
+  return !errors;
+}
+
+int main() {
+  bool bOK = true;
+  {
+    ring_t ring;
+    fifo_t fifo;
+    unsigned long ring_errors = s_check_bytes(ring, 100000);
+    unsigned long fifo_errors = s_check_bytes(fifo, 100000);
+    fprintf(stdout, "push/pop:   ring %lu errors, fifo %lu errors\n", ring_errors, fifo_errors);
+    bOK = bOK && !ring_errors;
+  }
+  {
+    ring_t ring;
+    fifo_t fifo;
+    unsigned long ring_errors = s_check_bulk(ring, 100000);
+    unsigned long fifo_errors = s_check_bulk(fifo, 100000);
+    fprintf(stdout, "read/write: ring %lu errors, fifo %lu errors%s\n", ring_errors, fifo_errors,
+            fifo_errors ? " (FIFO loses its place when a bulk copy wraps around)" : "");
+    bOK = bOK && !ring_errors;
+  }
+  bOK = s_check_threads() && bOK;
+
+  {
+    ring_t ring;
+    fifo_t fifo;
+    double t_ring = s_time_bytes(ring);
+    double t_fifo = s_time_bytes(fifo);
+    fprintf(stdout, "push/pop:   ring %.2f ns/byte, fifo %.2f ns/byte\n",
+            t_ring * 1E9 / BENCH_BYTES, t_fifo * 1E9 / BENCH_BYTES);
+  }
+  {
+    ring_t ring;
+    fifo_t fifo;
+    double t_ring = s_time_bulk(ring);
+    double t_fifo = s_time_bulk(fifo);
+    fprintf(stdout, "read/write: ring %.2f ns/byte, fifo %.2f ns/byte\n",
+            t_ring * 1E9 / BENCH_BYTES, t_fifo * 1E9 / BENCH_BYTES);
+  }
+
+  fprintf(stdout, "ring_bench: %s\n", bOK ? "OK" : "FAILED");
+  return bOK ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+/* scheduler_sim: Timer, and the Scheduler beneath it, on a virtual clock. Each callback advances the clock
+ * by what it would cost on the car, so a slow every_tenth() (e.g., a Bluetooth AT round trip) can be made
+ * to delay the 10ms control task, and the scheduler's lateness, overrun & skip counters checked against
+ * what happened. The fixed cascade that Timer::run() used before is run on the same load for comparison.
+ */
+
+#include "config.hh"
+#include "Timer.hh"
+
+#define SIM_DURATION 10000000UL // microseconds of virtual time per run
+#define SIM_TICK     10         // cost of the main loop's tick()
+
+struct Load {
+  unsigned long milli;  // cost of each callback, in microseconds
+  unsigned long pid;
+  unsigned long tenth;
+  unsigned long heavy;  // cost of every_tenth(5), once a second
+  unsigned long second;
+};
+
+/* Intervals between successive starts of the 10ms task
+ */
+class Intervals {
+private:
+  unsigned long m_last;
+  bool m_bFirst;
+public:
+  unsigned long count;
+  unsigned long min;
+  unsigned long max;
+
+  Intervals() : m_last(0), m_bFirst(true), count(0), min(~0UL), max(0) { }
+
+  void start(unsigned long t) {
+    if (!m_bFirst) {
+      unsigned long interval = t - m_last;
+      if (interval < min) min = interval;
+      if (interval > max) max = interval;
+    }
+    m_bFirst = false;
+    m_last = t;
+    ++count;
+  }
+};
+
+class SimTimer : public Timer {
+private:
+  const Load & m_load;
+  unsigned long m_start;
+public:
+  Intervals pid;
+
+  SimTimer(const Load & load) : m_load(load), m_start(micros()) { }
+
+  virtual void every_milli()  { host_clock += m_load.milli; }
+  virtual void every_10ms()   { pid.start(micros()); host_clock += m_load.pid; }
+  virtual void every_second() { host_clock += m_load.second; }
+
+  virtual void every_tenth(int tenth) {
+    host_clock += (tenth == 5) ? m_load.heavy : m_load.tenth;
+  }
+  virtual void tick() {
+    host_clock += SIM_TICK;
+    if (micros() - m_start >= SIM_DURATION) {
+      stop();
+    }
+  }
+
+  const Stats & stats_of(int task_id) const {
+    for (int i = 0; i < count(); i++) {
+      if (id(i) == task_id) {
+        return stats(i);
+      }
+    }
+    return stats(0);
+  }
+};
+
+/* The fixed every_milli/every_10ms/every_tenth/every_second cascade, as Timer::run() was
+ */
+static Intervals s_cascade(const Load & load) {
+  Intervals pid;
+  int count_ms = 0;
+  int count_10ms = 0;
+  int count_tenths = 0;
+  unsigned long start = micros();
+  unsigned long previous_time = millis();
+
+  while (micros() - start < SIM_DURATION) {
+    host_clock += SIM_TICK; // tick()
+
+    unsigned long current_time = millis();
+    if (current_time != previous_time) {
+      ++previous_time;
+      host_clock += load.milli;
+      if (++count_ms == 10) {
+        count_ms = 0;
+        pid.start(micros());
+        host_clock += load.pid;
+        if (++count_10ms == 10) {
+          count_10ms = 0;
+          host_clock += (count_tenths == 5) ? load.heavy : load.tenth;
+          if (++count_tenths == 10) {
+            count_tenths = 0;
+            host_clock += load.second;
+          }
+        }
+      }
+    }
+  }
+  return pid;
+}
+
+static bool s_run(const char * name, const Load & load, unsigned long clock) {
+  host_clock = 0; // the cascade counts in millis(), which only wraps around at 2^32 ms on the car
+  Intervals cascade = s_cascade(load);
+
+  host_clock = clock;
+  SimTimer T(load);
+  T.schedule(Timer::ti_User, 50000UL, 0, 0); // before run(), which must still add the standard tasks
+  T.run();
+
+  const Scheduler::Stats & S = T.stats_of(Timer::ti_10ms);
+  unsigned long expected = SIM_DURATION / 10000;
+
+  fprintf(stdout, "%s:\n", name);
+  fprintf(stdout, "  scheduler: 10ms task: %lu runs, interval %lu..%lu us; %lu late, %lu overruns, %lu skipped, lateness max %lu us\n",
+          S.runs, T.pid.min, T.pid.max, S.late, S.overruns, S.skipped, S.lateness_max);
+  fprintf(stdout, "  cascade:   10ms task: %lu runs, interval %lu..%lu us\n", cascade.count, cascade.min, cascade.max);
+
+  bool bOK = true;
+
+  if (S.runs + S.skipped + 1 < expected || S.runs + S.skipped > expected) { // every release either runs or is skipped
+    fprintf(stdout, "  FAIL: %lu runs + %lu skipped; expected %lu\n", S.runs, S.skipped, expected);
+    bOK = false;
+  }
+  if (load.heavy <= 10000 - load.pid) { // nothing ever makes the 10ms task miss its deadline
+    if (S.late || S.overruns || S.skipped) {
+      fprintf(stdout, "  FAIL: late, overrun or skipped under light load\n");
+      bOK = false;
+    }
+  } else { // each heavy tenth makes the 10ms task late, and a release is skipped rather than run back to back
+    unsigned long heavies = SIM_DURATION / 1000000;
+    if (S.late < heavies || S.skipped < heavies || S.lateness_max < load.heavy - 10000) {
+      fprintf(stdout, "  FAIL: lateness not recorded\n");
+      bOK = false;
+    }
+    if (T.pid.min < 1000) {
+      fprintf(stdout, "  FAIL: 10ms task ran back to back\n");
+      bOK = false;
+    }
+  }
+  return bOK;
+}
+
+int main() {
+  const Load light = { 20, 150, 300,   300, 500 };
+  const Load heavy = { 20, 150, 300, 25000, 500 }; // e.g., a blocking Bluetooth round trip once a second
+
+  bool bOK = true;
+
+  bOK = s_run("light load", light, 0) && bOK;
+  bOK = s_run("heavy tenth", heavy, 0) && bOK;
+  bOK = s_run("light load, clock wrapping around", light, 0UL - SIM_DURATION / 2) && bOK;
+  bOK = s_run("heavy tenth, clock wrapping around", heavy, 0UL - SIM_DURATION / 2) && bOK;
+
+  fprintf(stdout, "scheduler_sim: %s\n", bOK ? "OK" : "FAILED");
+  return bOK ? 0 : 1;
+}
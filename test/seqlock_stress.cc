@@ -0,0 +1,158 @@
+/* Copyright 2021 Francis James Franklin
+ *
+ * Open Source under the MIT License - see LICENSE in the project's root folder
+ */
+
+/* seqlock_stress: a writer thread updating the encoder snapshot as the edge interrupt does, and a reader
+ * thread copying it out as sync() does, concurrently; every copy must be consistent, the position must never
+ * go back, and the last copy must hold every count. Then the same with a wide value, to make a torn copy
+ * likely, against an unprotected copy of it for comparison.
+ */
+
+#include <atomic>
+#include <thread>
+
+#include "config.hh"
+#include "Encoders.hh"
+
+#define STRESS_UPDATES (1 << 24) // updates by the writer
+#define STRESS_WIDE    32        // words in the wide value
+
+struct Wide {
+  unsigned long word[STRESS_WIDE]; // all equal, when consistent
+};
+
+struct Result {
+  unsigned long reads;
+  unsigned long retries; // reads that needed more than one attempt
+  unsigned long torn;    // inconsistent copies
+  unsigned long back;    // copies older than the one before
+};
+
+/* As Encoder::edge(): each update is one count, and the other fields follow from the position
+ */
+static void s_update(Encoder::Snapshot & S) {
+  ++S.position;
+  S.time    = (unsigned long) S.position * 3;
+  S.illegal = (unsigned long) S.position / 5;
+  S.dropped = (unsigned long) S.position / 7;
+}
+
+static bool s_consistent(const Encoder::Snapshot & S) {
+  return (S.time    == (unsigned long) S.position * 3)
+      && (S.illegal == (unsigned long) S.position / 5)
+      && (S.dropped == (unsigned long) S.position / 7);
+}
+
+static bool s_consistent(const Wide & W) {
+  for (int i = 1; i < STRESS_WIDE; i++) {
+    if (W.word[i] != W.word[0]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool s_snapshot() {
+  static SeqLock<Encoder::Snapshot> lock;
+  std::atomic<bool> bDone(false);
+  Result R = { 0, 0, 0, 0 };
+
+  std::thread writer([&] {
+    for (long n = 0; n < STRESS_UPDATES; n++) {
+      s_update(lock.write_begin());
+      lock.write_end();
+    }
+    bDone = true;
+  });
+
+  long last = 0;
+  Encoder::Snapshot S;
+  do {
+    bool bFinal = bDone; // the writer had finished before this copy
+    if (lock.read(S) > 1) {
+      ++R.retries;
+    }
+    ++R.reads;
+    if (!s_consistent(S)) {
+      ++R.torn;
+    }
+    if (S.position < last) {
+      ++R.back;
+    }
+    last = S.position;
+    if (bFinal) {
+      break;
+    }
+  } while (true);
+  writer.join();
+
+  bool bOK = !R.torn && !R.back && (last == STRESS_UPDATES);
+
+  fprintf(stdout, "snapshot: %lu reads, %lu retried, %lu torn, %lu out of order; final position %ld of %d: %s\n",
+          R.reads, R.retries, R.torn, R.back, last, STRESS_UPDATES, bOK ? "OK" : "FAILED");
+  return bOK;
+}
+
+static bool s_wide() {
+  static SeqLock<Wide> lock;
+  static volatile unsigned long plain[STRESS_WIDE]; // the same, with no lock
+  std::atomic<bool> bDone(false);
+  Result R = { 0, 0, 0, 0 };
+  unsigned long plain_torn = 0;
+
+  std::thread writer([&] {
+    for (unsigned long n = 1; n <= STRESS_UPDATES / 4; n++) {
+      Wide & W = lock.write_begin();
+      for (int i = 0; i < STRESS_WIDE; i++) {
+        W.word[i] = n;
+      }
+      lock.write_end();
+
+      for (int i = 0; i < STRESS_WIDE; i++) {
+        plain[i] = n;
+      }
+    }
+    bDone = true;
+  });
+
+  Wide W;
+  do {
+    bool bFinal = bDone;
+    if (lock.read(W) > 1) {
+      ++R.retries;
+    }
+    ++R.reads;
+    if (!s_consistent(W)) {
+      ++R.torn;
+    }
+
+    Wide P;
+    for (int i = 0; i < STRESS_WIDE; i++) {
+      P.word[i] = plain[i];
+    }
+    if (!s_consistent(P)) {
+      ++plain_torn;
+    }
+    if (bFinal) {
+      break;
+    }
+  } while (true);
+  writer.join();
+
+  bool bOK = !R.torn && (W.word[0] == STRESS_UPDATES / 4);
+
+  fprintf(stdout, "wide:     %lu reads, %lu retried, %lu torn (%lu torn without the lock): %s\n",
+          R.reads, R.retries, R.torn, plain_torn, bOK ? "OK" : "FAILED");
+  return bOK;
+}
+
+int main() {
+  fprintf(stdout, "seqlock: %u hardware threads\n", std::thread::hardware_concurrency());
+
+  bool bOK = s_snapshot();
+  bOK = s_wide() && bOK;
+
+  fprintf(stdout, "seqlock_stress: %s\n", bOK ? "OK" : "FAILED");
+  return bOK ? 0 : 1;
+}
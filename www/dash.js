@@ -48,6 +48,10 @@ function mqtt_receive_slip (str) {
     l = parseFloat (lr_str[0]);
     r = parseFloat (lr_str[1]);
 
+    dash_slip (l, r);
+}
+
+function dash_slip (l, r) {
     var g3_rotate = -60 * l;
     svg_dial_needle ("g3", g3_rotate);
 
@@ -55,6 +59,41 @@ function mqtt_receive_slip (str) {
     svg_dial_needle ("g4", g4_rotate);
 }
 
+/* Decode /cariot/car/state; see CARIOT_STATE_VERSION in src/car.cc for the schema:
+ * binary is [version=1][n][n x little-endian int16 (value x 1000)], text is "x y l r"
+ */
+var CARIOT_STATE_VERSION = 1;
+
+function mqtt_receive_state (bytes) {
+    var x, y, l, r;
+
+    if (bytes.length >= 2 && bytes[0] == CARIOT_STATE_VERSION) {
+	var n = bytes[1];
+	if (bytes.length < 2 + 2 * n || n < 4) {
+	    return false;
+	}
+	var view = new DataView (bytes.buffer, bytes.byteOffset, bytes.length);
+
+	x = view.getInt16 (2, true) / 1000;
+	y = view.getInt16 (4, true) / 1000;
+	l = view.getInt16 (6, true) / 1000;
+	r = view.getInt16 (8, true) / 1000;
+    } else {
+	var str = String.fromCharCode.apply (null, bytes);
+	var state_str = str.split (" ");
+	if (state_str.length < 4) {
+	    return false;
+	}
+	x = parseFloat (state_str[0]);
+	y = parseFloat (state_str[1]);
+	l = parseFloat (state_str[2]);
+	r = parseFloat (state_str[3]);
+    }
+    blue_circle (x, y);
+    dash_slip (l, r);
+    return true;
+}
+
 function user_control (x, y) { // -1 <= x,y <= 1
     var value_x = document.getElementById ("value_x");
     var value_y = document.getElementById ("value_y");
@@ -320,6 +359,14 @@ function onConnectionLost (responseObject) {
 
 // called when a message arrives
 function onMessageArrived (message) {
+    if (message.destinationName == "/cariot/car/state") {
+	if (mqtt_receive_state (message.payloadBytes)) {
+	    mqtt_log_update ("state: " + message.payloadBytes.length + " bytes");
+	} else {
+	    mqtt_log_update ("state: bad payload");
+	}
+	return;
+    }
     mqtt_log_update ("onMessageArrived:" + message.payloadString);
 
     if (message.destinationName == "/cariot/car/XY") {